@@ -1,5 +1,6 @@
 #pragma once
 #define DEBUG
 //#define DEBUG_ALARM_TIME
+//#define SD1306_BENCHMARK
 
 #define IOT_CENTRAL_APPLICATION
\ No newline at end of file
@@ -141,6 +141,248 @@ int WaitForEventAndCallHandler(int epollFd)
 	return 0;
 }
 
+int WaitForEventsAndCallHandlers(int epollFd, PostDispatchHook postDispatchHook)
+{
+	struct epoll_event events[MAX_EVENTS_PER_WAIT];
+	int numEventsOccurred = epoll_wait(epollFd, events, MAX_EVENTS_PER_WAIT, -1);
+
+	if (numEventsOccurred == -1) {
+		if (errno == EINTR) {
+			// interrupted by signal, e.g. due to breakpoint being set; ignore
+			return 0;
+		}
+		Log_Debug("ERROR: Failed waiting on events: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+
+	for (int i = 0; i < numEventsOccurred; i++) {
+		EventData* eventData = events[i].data.ptr;
+		if (eventData != NULL) {
+			eventData->eventHandler(eventData);
+		}
+	}
+
+	if (postDispatchHook != NULL) {
+		postDispatchHook();
+	}
+
+	return numEventsOccurred;
+}
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static uint64_t MonotonicMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// Rounded up, so a timer never expires early
+static uint64_t TimespecToMs(const struct timespec* value)
+{
+	return (uint64_t)value->tv_sec * 1000 + ((uint64_t)value->tv_nsec + 999999) / 1000000;
+}
+
+static void TimerWheelLink(TimerWheel* wheel, LogicalTimer* timer)
+{
+	uint64_t placed = timer->deadlineMs;
+	uint64_t delta = placed - wheel->nowMs;
+	uint8_t level = 0;
+
+	// Level l holds the timers due within SLOTS^(l + 1) ms, beyond the top level they wait in its last slot
+	while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+		level++;
+	}
+	if (delta >= (1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS))) {
+		placed = wheel->nowMs + (1ULL << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1;
+	}
+
+	uint8_t slot = (placed >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+	LogicalTimer** head = &wheel->slots[level][slot];
+	timer->placedMs = placed;
+	timer->level = level;
+	timer->slot = slot;
+	timer->next = *head;
+	timer->prevNext = head;
+	if (*head != NULL) {
+		(*head)->prevNext = &timer->next;
+	}
+	*head = timer;
+	wheel->occupied[level] |= 1ULL << slot;
+}
+
+static void TimerWheelUnlink(TimerWheel* wheel, LogicalTimer* timer)
+{
+	*timer->prevNext = timer->next;
+	if (timer->next != NULL) {
+		timer->next->prevNext = timer->prevNext;
+	}
+	timer->prevNext = NULL;
+	if (wheel->slots[timer->level][timer->slot] == NULL) {
+		wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+	}
+}
+
+// Slots of a level come due in order and cover disjoint times, so the earliest deadline is in
+// the first occupied slot after the current one of some level
+static uint64_t TimerWheelNextDeadline(const TimerWheel* wheel)
+{
+	uint64_t earliest = UINT64_MAX;
+
+	for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint64_t occupied = wheel->occupied[level];
+		if (occupied == 0) {
+			continue;
+		}
+		uint8_t first = ((wheel->nowMs >> (TIMER_WHEEL_SLOT_BITS * level)) + 1) & TIMER_WHEEL_SLOT_MASK;
+		uint64_t rotated = first == 0 ? occupied : (occupied >> first) | (occupied << (TIMER_WHEEL_SLOTS - first));
+		uint8_t slot = (first + __builtin_ctzll(rotated)) & TIMER_WHEEL_SLOT_MASK;
+		for (const LogicalTimer* timer = wheel->slots[level][slot]; timer != NULL; timer = timer->next) {
+			if (timer->placedMs < earliest) {
+				earliest = timer->placedMs;
+			}
+		}
+	}
+	return earliest;
+}
+
+static int TimerWheelArm(TimerWheel* wheel, uint64_t deadlineMs)
+{
+	struct itimerspec newValue = { .it_value = {}, .it_interval = {} };
+
+	if (deadlineMs != UINT64_MAX) {
+		newValue.it_value.tv_sec = (time_t)(deadlineMs / 1000);
+		newValue.it_value.tv_nsec = (long)(deadlineMs % 1000) * 1000000;
+	}
+	if (timerfd_settime(wheel->eventData.fd, TFD_TIMER_ABSTIME, &newValue, NULL) < 0) {
+		Log_Debug("ERROR: Could not set timer wheel timerfd: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+	wheel->armedMs = deadlineMs == UINT64_MAX ? 0 : deadlineMs;
+	return 0;
+}
+
+// Moves the timers of the higher level slots that came due at time down the wheel
+static void TimerWheelCascade(TimerWheel* wheel, uint64_t time)
+{
+	for (uint8_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		uint8_t slot = (time >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+		LogicalTimer* timer = wheel->slots[level][slot];
+		wheel->slots[level][slot] = NULL;
+		wheel->occupied[level] &= ~(1ULL << slot);
+		while (timer != NULL) {
+			LogicalTimer* next = timer->next;
+			TimerWheelLink(wheel, timer);
+			timer = next;
+		}
+		// The next level only comes due when this one wraps around
+		if (slot != 0) {
+			break;
+		}
+	}
+}
+
+// Runs every timer due up to targetMs, jumping from one occupied slot or level wrap to the next
+static void TimerWheelAdvance(TimerWheel* wheel, uint64_t targetMs)
+{
+	while (wheel->nowMs < targetMs) {
+		uint64_t time = wheel->nowMs + 1;
+		// A wrap has to cascade before anything is skipped
+		if ((time & TIMER_WHEEL_SLOT_MASK) != 0) {
+			uint64_t pending = wheel->occupied[0] >> (time & TIMER_WHEEL_SLOT_MASK);
+			time = pending != 0 ? time + __builtin_ctzll(pending) : (time | TIMER_WHEEL_SLOT_MASK) + 1;
+		}
+		if (time > targetMs) {
+			wheel->nowMs = targetMs;
+			break;
+		}
+
+		wheel->nowMs = time;
+		if ((time & TIMER_WHEEL_SLOT_MASK) == 0) {
+			TimerWheelCascade(wheel, time);
+		}
+
+		// One at a time, handlers may start and stop any timer, this one included
+		LogicalTimer* timer;
+		while ((timer = wheel->slots[0][time & TIMER_WHEEL_SLOT_MASK]) != NULL) {
+			TimerWheelUnlink(wheel, timer);
+			if (timer->periodMs != 0) {
+				// Expiries missed while the loop was busy are dropped rather than run in a burst
+				timer->deadlineMs += timer->periodMs;
+				if (timer->deadlineMs <= targetMs) {
+					timer->deadlineMs = targetMs + timer->periodMs;
+				}
+				TimerWheelLink(wheel, timer);
+			}
+			timer->handler(timer);
+		}
+	}
+}
+
+static void TimerWheelEventHandler(EventData* eventData)
+{
+	// The wheel is laid out with its event data first
+	TimerWheel* wheel = (TimerWheel*)eventData;
+	uint64_t expirations;
+
+	// Nothing to read when a handler earlier in the batch re-armed the timerfd, that is fine
+	if (read(wheel->eventData.fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+		Log_Debug("ERROR: Could not read timer wheel timerfd %s (%d).\n", strerror(errno), errno);
+	}
+
+	TimerWheelAdvance(wheel, MonotonicMs());
+	TimerWheelArm(wheel, TimerWheelNextDeadline(wheel));
+}
+
+int CreateTimerWheelAndAddToEpoll(int epollFd, TimerWheel* wheel)
+{
+	memset(wheel, 0, sizeof(*wheel));
+	wheel->eventData.eventHandler = &TimerWheelEventHandler;
+	wheel->nowMs = MonotonicMs();
+
+	int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (timerFd < 0) {
+		Log_Debug("ERROR: Could not create timer wheel timerfd: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+
+	wheel->eventData.fd = timerFd;
+	if (RegisterEventHandlerToEpoll(epollFd, timerFd, &wheel->eventData, EPOLLIN) != 0) {
+		close(timerFd);
+		return -1;
+	}
+
+	return timerFd;
+}
+
+int StartLogicalTimer(TimerWheel* wheel, LogicalTimer* timer, const struct timespec* delay,
+	const struct timespec* period)
+{
+	StopLogicalTimer(wheel, timer);
+
+	// Slots up to nowMs have run, the earliest a timer can still be seen is the next one
+	timer->deadlineMs = MonotonicMs() + TimespecToMs(delay);
+	if (timer->deadlineMs <= wheel->nowMs) {
+		timer->deadlineMs = wheel->nowMs + 1;
+	}
+	timer->periodMs = period != NULL ? TimespecToMs(period) : 0;
+	TimerWheelLink(wheel, timer);
+
+	if (wheel->armedMs == 0 || timer->placedMs < wheel->armedMs) {
+		return TimerWheelArm(wheel, timer->placedMs);
+	}
+	return 0;
+}
+
+void StopLogicalTimer(TimerWheel* wheel, LogicalTimer* timer)
+{
+	// The timerfd stays armed, an expiry with nothing due only re-arms it
+	if (timer->prevNext != NULL) {
+		TimerWheelUnlink(wheel, timer);
+	}
+}
+
 void CloseFdAndPrintError(int fd, const char* fdName)
 {
 	if (fd >= 0) {
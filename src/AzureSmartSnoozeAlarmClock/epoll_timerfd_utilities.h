@@ -2,6 +2,7 @@
    Licensed under the MIT License. */
 
 #pragma once
+#include <stdint.h>
 #include <time.h>
 #include <sys/epoll.h>
 #include <unistd.h>
@@ -105,6 +106,113 @@ int CreateTimerFdAndAddToEpoll(int epollFd, const struct timespec* period,
 /// <returns>0 on success, or -1 on failure</returns>
 int WaitForEventAndCallHandler(int epollFd);
 
+/// <summary>
+///     Most events <see cref="WaitForEventsAndCallHandlers" /> takes from one epoll_wait.
+/// </summary>
+#define MAX_EVENTS_PER_WAIT 8
+
+/// <summary>
+///     Function signature for the hook run once after a batch of handlers.
+/// </summary>
+typedef void (*PostDispatchHook)(void);
+
+/// <summary>
+///     Waits for events on an epoll instance, triggers the handler of every event that is ready,
+///     up to MAX_EVENTS_PER_WAIT, then runs the post-dispatch hook once for the whole batch.
+///     Handlers must not free the event data of other events, those may still be in the batch.
+/// </summary>
+/// <param name="epollFd">
+///     Epoll file descriptor which was created with <see cref="CreateEpollFd" />.
+/// </param>
+/// <param name="postDispatchHook">Called after the handlers, or NULL</param>
+/// <returns>The number of events handled on success, or -1 on failure</returns>
+int WaitForEventsAndCallHandlers(int epollFd, PostDispatchHook postDispatchHook);
+
+/// <summary>
+///     Levels of a timer wheel, each with TIMER_WHEEL_SLOTS slots of 1 ms, 64 ms, 4 s and 4.4 min.
+///     Timers further out than the top level wait in its last slot and are placed again later.
+/// </summary>
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+
+/// Forward declaration of the data type passed to the logical timer handlers.
+struct LogicalTimer;
+
+/// <summary>
+///     Function signature for logical timer handlers.
+/// </summary>
+/// <param name="timer">The timer that expired</param>
+typedef void (*LogicalTimerHandler)(struct LogicalTimer* timer);
+
+/// <summary>
+/// <para>A one-shot or periodic timer run by a <see cref="TimerWheel" />.</para>
+/// <para>Set the handler, the other fields belong to the wheel. The timer must remain valid
+/// for as long as it is running.</para>
+/// </summary>
+typedef struct LogicalTimer {
+	/// <summary>
+	/// Function which is called when the timer expires.
+	/// </summary>
+	LogicalTimerHandler handler;
+	uint64_t deadlineMs;
+	// Deadline the slot was picked with, earlier than deadlineMs for timers beyond the top level
+	uint64_t placedMs;
+	uint64_t periodMs;
+	struct LogicalTimer* next;
+	// NULL while the timer is not running
+	struct LogicalTimer** prevNext;
+	uint8_t level;
+	uint8_t slot;
+} LogicalTimer;
+
+/// <summary>
+/// <para>Hierarchical timer wheel that runs any number of logical timers off one
+/// CLOCK_MONOTONIC timerfd, armed for the earliest deadline. Starting and stopping a timer is
+/// O(1). Resolution is 1 ms.</para>
+/// <para>Create it with <see cref="CreateTimerWheelAndAddToEpoll" />, the handlers run from
+/// the epoll dispatch.</para>
+/// </summary>
+typedef struct TimerWheel {
+	/// <summary>
+	/// Epoll registration of the timerfd, eventData.fd is the timerfd.
+	/// </summary>
+	EventData eventData;
+	// Every slot up to this time has been run
+	uint64_t nowMs;
+	// Time the timerfd expires at, 0 while it is disarmed
+	uint64_t armedMs;
+	uint64_t occupied[TIMER_WHEEL_LEVELS];
+	LogicalTimer* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TimerWheel;
+
+/// <summary>
+///     Creates the timerfd of a timer wheel and adds it to an epoll instance.
+/// </summary>
+/// <param name="epollFd">Epoll file descriptor</param>
+/// <param name="wheel">Persistent timer wheel. This must stay in memory until the timerfd is
+/// removed from the epoll.</param>
+/// <returns>A valid timerfd file descriptor on success, or -1 on failure</returns>
+int CreateTimerWheelAndAddToEpoll(int epollFd, TimerWheel* wheel);
+
+/// <summary>
+///     Starts a logical timer, or restarts it if it is already running.
+/// </summary>
+/// <param name="wheel">Timer wheel to run the timer</param>
+/// <param name="timer">Persistent timer with its handler set</param>
+/// <param name="delay">Time until the first expiry</param>
+/// <param name="period">Time between the expiries after the first, NULL or zero for one-shot</param>
+/// <returns>0 on success, or -1 on failure</returns>
+int StartLogicalTimer(TimerWheel* wheel, LogicalTimer* timer, const struct timespec* delay,
+	const struct timespec* period);
+
+/// <summary>
+///     Stops a logical timer, does nothing if it is not running.
+/// </summary>
+/// <param name="wheel">Timer wheel running the timer</param>
+/// <param name="timer">Timer to stop</param>
+void StopLogicalTimer(TimerWheel* wheel, LogicalTimer* timer);
+
 /// <summary>
 ///     Closes a file descriptor and prints an error on failure.
 /// </summary>
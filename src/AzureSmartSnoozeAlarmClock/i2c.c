@@ -1,13 +1,25 @@
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <applibs/i2c.h>
 #include <applibs/log.h>
 #include <hw/avnet_mt3620_sk.h>
 #include "i2c.h"
 
+// SSD1306 no operation command, harmless to send to the display at any time
+#define I2C_PROBE_NOP 0xE3
+// Bytes per probe write, control byte included, about the size of one display page
+#define I2C_PROBE_LENGTH 129
+// Probe writes per bus speed
+#define I2C_PROBE_WRITES 4
+#define I2C_TIMEOUT_MS 100
+
 int i2cFd = -1;
 
+static uint32_t i2cBusSpeed = I2C_BUS_SPEED_STANDARD;
+static uint32_t i2cBytesPerSecond = 0;
+
 int initI2c(void) {
 	if ((i2cFd = I2CMaster_Open(AVNET_MT3620_SK_ISU2_I2C)) < 0) {
 		Log_Debug("Error: I2CMaster_Open: i2cFd=%d (%s).\n", i2cFd, strerror(errno));
@@ -18,14 +30,94 @@ int initI2c(void) {
 		Log_Debug("Error: I2CMaster_SetBusSpeed: errno=%d (%s).\n", errno, strerror(errno));
 		return -1;
 	}
+	i2cBusSpeed = I2C_BUS_SPEED_STANDARD;
+	i2cBytesPerSecond = 0;
 
-	if (I2CMaster_SetTimeout(i2cFd, 100) != 0) {
+	if (I2CMaster_SetTimeout(i2cFd, I2C_TIMEOUT_MS) != 0) {
 		Log_Debug("Error: I2CMaster_SetTimeout: errno=%d (%s).\n", errno, strerror(errno));
 		return -1;
 	}
 	return 0;
 }
 
+// Returns the bytes/s probe writes achieve at the current bus speed, 0 if a write failed
+static uint32_t probeI2c(uint32_t address) {
+	uint8_t probe[I2C_PROBE_LENGTH];
+	struct timespec start;
+	struct timespec end;
+
+	// Command stream of no operations
+	probe[0] = 0x00;
+	memset(&probe[1], I2C_PROBE_NOP, sizeof(probe) - 1);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < I2C_PROBE_WRITES; i++) {
+		if (I2CMaster_Write(i2cFd, address, probe, sizeof(probe)) != sizeof(probe)) {
+			return 0;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint64_t elapsedNs = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (uint64_t)(end.tv_nsec - start.tv_nsec);
+	if (elapsedNs == 0) {
+		elapsedNs = 1;
+	}
+	return (uint32_t)((uint64_t)sizeof(probe) * I2C_PROBE_WRITES * 1000000000 / elapsedNs);
+}
+
+int negotiateI2cSpeed(uint32_t address) {
+	static const uint32_t speeds[] = { I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST, I2C_BUS_SPEED_STANDARD };
+	uint32_t bestSpeed = 0;
+	uint32_t bestBytesPerSecond = 0;
+
+	// An accepted speed is not always a faster one, the controller may round it down or the device
+	// may stretch the clock, so time every speed that works and keep the one that moved the most data
+	for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+		if (speeds[i] > I2C_MAX_BUS_SPEED) {
+			continue;
+		}
+		if (I2CMaster_SetBusSpeed(i2cFd, speeds[i]) != 0) {
+			Log_Debug("Info: I2C bus speed %u Hz not supported: errno=%d (%s).\n", speeds[i], errno, strerror(errno));
+			continue;
+		}
+
+		uint32_t bytesPerSecond = probeI2c(address);
+		if (bytesPerSecond == 0) {
+			Log_Debug("Info: I2C writes fail at %u Hz: errno=%d (%s).\n", speeds[i], errno, strerror(errno));
+			continue;
+		}
+
+		Log_Debug("Info: I2C bus speed %u Hz moves %u bytes/s.\n", speeds[i], bytesPerSecond);
+		if (bytesPerSecond > bestBytesPerSecond) {
+			bestSpeed = speeds[i];
+			bestBytesPerSecond = bytesPerSecond;
+		}
+	}
+
+	if (bestSpeed == 0) {
+		Log_Debug("Error: No I2C bus speed works with device 0x%02x.\n", address);
+		I2CMaster_SetBusSpeed(i2cFd, i2cBusSpeed);
+		return -1;
+	}
+
+	if (I2CMaster_SetBusSpeed(i2cFd, bestSpeed) != 0) {
+		Log_Debug("Error: I2CMaster_SetBusSpeed: errno=%d (%s).\n", errno, strerror(errno));
+		I2CMaster_SetBusSpeed(i2cFd, i2cBusSpeed);
+		return -1;
+	}
+	i2cBusSpeed = bestSpeed;
+	i2cBytesPerSecond = bestBytesPerSecond;
+	return 0;
+}
+
+uint32_t getI2cBusSpeed(void) {
+	return i2cBusSpeed;
+}
+
+uint32_t getI2cBytesPerSecond(void) {
+	return i2cBytesPerSecond;
+}
+
 void closeI2c(void) {
 	//CloseFdAndPrintError(i2cFd, "i2c");
 	if (i2cFd >= 0) {
@@ -1,8 +1,21 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Fastest speed negotiation tries. The SSD1306 is only specified up to fast mode and the probe can
+// only see that writes are ACKed, not that the data arrived intact, so faster needs a tested panel.
+#ifndef I2C_MAX_BUS_SPEED
+#define I2C_MAX_BUS_SPEED I2C_BUS_SPEED_FAST
+#endif
 
 int initI2c(void);
+// Picks the bus speed up to I2C_MAX_BUS_SPEED that moves the most bytes/s to the SSD1306 at address,
+// falls back to slower ones and keeps the current speed if none works
+int negotiateI2cSpeed(uint32_t address);
+uint32_t getI2cBusSpeed(void);
+// Bytes/s measured at the current speed, 0 until a negotiation succeeds
+uint32_t getI2cBytesPerSecond(void);
 void closeI2c(void);
 
 extern int i2cFd;
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <time.h>
+#include <sys/timerfd.h>
 
 #include <applibs/log.h>
 #include <applibs/gpio.h>
@@ -12,7 +13,12 @@
 #include "azure_iot_utilities.h"
 #include "build_options.h"
 #include "epoll_timerfd_utilities.h"
+#include "i2c.h"
 #include "sd1306.h"
+#include "sd1306_benchmark.h"
+#include "sd1306_widget.h"
+#include "splash_img.h"
+#include "state_machine.h"
 
 
 #define INVALID_DATE_TIME 1262304000 //unix time for 1/1/2010, used to know when got time from NTP server 
@@ -21,50 +27,114 @@
 #define STORAGE_HOUR_SIZE 1
 #define STORAGE_MINUTE_SIZE 1
 #define STORAGE_OFFSET_SIZE 4
-#define STORAGE_TIME_ZONE_SIZE 3
+#define STORAGE_TIME_ZONE_SIZE TIME_ZONE_LENGTH
 #define NTP_SYNC_RETRIES 10
+#define SLIDE_STEP_MS 25
+#define RENDER_STATS_PERIOD 10
+// Buttons are sampled slowly while idle and fast from the first change until they have been quiet
+#define BUTTON_POLL_IDLE_MS 30
+#define BUTTON_POLL_ACTIVE_MS 1
+#define BUTTON_POLL_QUIET_MS 1000
 
 // Azure IoT Hub/Central defines.
 #define SCOPEID_LENGTH 20
 char scopeId[SCOPEID_LENGTH]; // ScopeId for the Azure IoT Central application and DPS set in app_manifest.json, CmdArgs
 
-void buttonTimerEventHandler(EventData* eventData);
-void buzzerTimerEventHandler(EventData* eventData);
+void buttonTimerEventHandler(LogicalTimer* timer);
+void buzzerTimerEventHandler(LogicalTimer* timer);
+void renderTimerEventHandler(LogicalTimer* timer);
+void snoozeTimerEventHandler(LogicalTimer* timer);
+void minuteTimerEventHandler(EventData* eventData);
+void alarmTimerEventHandler(EventData* eventData);
+void requestRender(void);
+void afterEvents(void);
 void terminationHandler(int signalNumber);
-enum buttonName {ButtonA, ButtonB, ButtonC, ButtonSet};
-enum runningState{ Normal, DisplayAlarm, SetSettings, SetTimeZone, SetAlarmHour, SetAlarmMinute, SoundAlarm, Snooze };
-typedef struct AlarmTime {
-	uint8_t hour;
-	uint8_t minute;
-	uint16_t offsetSeconds;
-	time_t currentAlarmTime;
-	bool active;
-} AlarmTime;
-
-int buttonAFd = -1;
-int buttonBFd = -1;
-int buttonCFd = -1;
-int buttonSetFd = -1;
-int buttonPollTimerFd = -1;
+bool pollButton(enum buttonName button);
+int setButtonPollPeriod(bool fast);
+void checkAlarm(void);
+bool alarmPassedOnSyncedClock(void);
+void scheduleAlarm(void);
+int saveSettings(void);
+int applyTimeZone(void);
+void setCurrentAlarm(void);
+void endSoundAlarm(void);
+void startSnooze(void);
+typedef struct Button {
+	int gpio;
+	const char* name;
+	int fd;
+} Button;
+
 int buzzerFd = -1;
-int buzzerPollTimerFd = -1;
+int minuteTimerFd = -1;
+int alarmTimerFd = -1;
 int epollFd = -1;
-char timezone[STORAGE_TIME_ZONE_SIZE + 1] = { 0 };
 volatile sig_atomic_t terminationRequired = false;
-enum runningState currentState = Normal;
-GPIO_Value_Type buttonAState;
-GPIO_Value_Type buttonBState;
-GPIO_Value_Type buttonCState;
-GPIO_Value_Type buttonSetState;
-EventData buttonEventData = { .eventHandler = &buttonTimerEventHandler };
-EventData buzzerEventData = { .eventHandler = &buzzerTimerEventHandler };
-AlarmTime alarmTime = { .hour = 0, .minute = 0, .offsetSeconds = 0, .currentAlarmTime = 0, .active = false};
+enum runningState displayedState = Normal;
+Button buttons[ButtonCount] = {
+	[ButtonA] = { .gpio = AVNET_MT3620_SK_GPIO42, .name = "Button A", .fd = -1 },
+	[ButtonB] = { .gpio = AVNET_MT3620_SK_GPIO43, .name = "Button B", .fd = -1 },
+	[ButtonC] = { .gpio = AVNET_MT3620_SK_USER_BUTTON_A, .name = "Button C", .fd = -1 },
+	[ButtonSet] = { .gpio = AVNET_MT3620_SK_USER_BUTTON_B, .name = "Button Set", .fd = -1 }
+};
+EventData minuteEventData = { .eventHandler = &minuteTimerEventHandler };
+EventData alarmEventData = { .eventHandler = &alarmTimerEventHandler };
+// Every monotonic timer runs off the one timerfd of the wheel
+TimerWheel timerWheel = { .eventData = { .fd = -1 } };
+LogicalTimer buttonPollTimer = { .handler = &buttonTimerEventHandler };
+LogicalTimer buzzerTimer = { .handler = &buzzerTimerEventHandler };
+LogicalTimer renderTimer = { .handler = &renderTimerEventHandler };
+LogicalTimer snoozeTimer = { .handler = &snoozeTimerEventHandler };
 struct timespec soundAlarmStarted;
-struct timespec snoozeTime;
+
+// Clock face and alarm screen widgets, only re-rendered when their text changes
+struct sd1306_widget timeWidget;
+struct sd1306_widget dateWidget;
+struct sd1306_widget buzzzWidget;
+struct sd1306_widget alarmStatusWidget;
+struct sd1306_widget alarmTimeWidget;
+struct sd1306_widget* const clockWidgets[] = { &timeWidget, &dateWidget, &buzzzWidget };
+struct sd1306_widget* const alarmWidgets[] = { &alarmStatusWidget, &alarmTimeWidget };
+// Widgets OLED buffer holds, NULL when something else was drawn
+struct sd1306_widget* const* composedWidgets = NULL;
+
+// Frames are only drawn when something asked for one, never faster than the state allows
+const uint8_t maxFramesPerSecond[] = {
+	[Normal] = 2,
+	[DisplayAlarm] = 10,
+	[SetSettings] = 10,
+	[SetTimeZone] = 20,
+	[SetAlarmHour] = 20,
+	[SetAlarmMinute] = 20,
+	[SoundAlarm] = 2,
+	[Snooze] = 2
+};
+bool renderRequested = true;
+bool renderTimerArmed = false;
+struct timespec lastRender;
+uint32_t wakeupCount = 0;
+uint32_t eventCount = 0;
+uint32_t renderCount = 0;
+uint32_t buttonPollCount = 0;
+bool buttonPollFast = false;
+struct timespec lastButtonActivity;
+struct timespec renderStatsStarted;
+
+
+// Side effects of the button transitions in state_machine.c
+const StateMachineHooks stateMachineHooks = {
+	.saveSettings = &saveSettings,
+	.setCurrentAlarm = &setCurrentAlarm,
+	.setTimeZone = &applyTimeZone,
+	.endSoundAlarm = &endSoundAlarm,
+	.startSnooze = &startSnooze,
+	.requestRender = &requestRender
+};
 
 
 int setup() {
 	initializeTerminationHandler();
+	setStateMachineHooks(&stateMachineHooks);
 
 	if (loadSettings() < 0) {
 		Log_Debug("Error: Could not load settings from storage.\n");
@@ -111,42 +181,88 @@ int initializeIOPorts() {
 }
 
 int initializeGPIOs() {
-	if ((buttonAFd = openAsInput(AVNET_MT3620_SK_GPIO42)) < 0) {
-		Log_Debug("Error: Could not open button A GPIO.\n");
+	for (int i = 0; i < ButtonCount; i++) {
+		if ((buttons[i].fd = openAsInput(buttons[i].gpio)) < 0) {
+			Log_Debug("Error: Could not open %s GPIO.\n", buttons[i].name);
+			return -1;
+		}
+		GPIO_Value_Type level;
+		if (GPIO_GetValue(buttons[i].fd, &level) != 0) {
+			level = GPIO_Value_High;
+		}
+		resetButton(i, level == GPIO_Value_Low);
+	}
+	if ((buzzerFd = openAsOutput(AVNET_MT3620_SK_GPIO0)) < 0) {
+		Log_Debug("Error: Could not open buzzer GPIO.\n");
 		return -1;
 	}
-	if ((buttonBFd = openAsInput(AVNET_MT3620_SK_GPIO43)) < 0) {
-		Log_Debug("Error: Could not open button B GPIO.\n");
+
+	return 0;
+}
+
+int initializeButtonEpollTimer() {
+	if ((epollFd = CreateEpollFd()) < 0) {
+		Log_Debug("Error: Could not create Epoll file descriptor.\n");
 		return -1;
 	}
-	if ((buttonCFd = openAsInput(AVNET_MT3620_SK_USER_BUTTON_A)) < 0) {
-		Log_Debug("Error: Could not open button C GPIO.\n");
+	if (CreateTimerWheelAndAddToEpoll(epollFd, &timerWheel) < 0) {
 		return -1;
 	}
-	if ((buttonSetFd = openAsInput(AVNET_MT3620_SK_USER_BUTTON_B)) < 0) {
-		Log_Debug("Error: Could not open button SET GPIO.\n");
+
+	// The render and snooze timers only run while something is due
+	if (setButtonPollPeriod(false) != 0) {
 		return -1;
 	}
-	if ((buzzerFd = openAsOutput(AVNET_MT3620_SK_GPIO0)) < 0) {
-		Log_Debug("Error: Could not open buzzer GPIO.\n");
+
+	struct timespec buzzerInterval = { 0, 100000000 };
+	if (StartLogicalTimer(&timerWheel, &buzzerTimer, &buzzerInterval, &buzzerInterval) != 0) {
+		return -1;
+	}
+
+	// Wall clock timer so the clock face changes right on the minute, it is cancelled and re-armed when NTP sets the time
+	if ((minuteTimerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK)) < 0) {
+		Log_Debug("Error: Could not create minute timerfd: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+	if (armMinuteTimer() < 0) {
+		return -1;
+	}
+	if (RegisterEventHandlerToEpoll(epollFd, minuteTimerFd, &minuteEventData, EPOLLIN) != 0) {
 		return -1;
 	}
 
+	// Armed at the alarm time by setCurrentAlarm, the kernel cancels it if the clock gets set
+	if ((alarmTimerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK)) < 0) {
+		Log_Debug("Error: Could not create alarm timerfd: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+	if (RegisterEventHandlerToEpoll(epollFd, alarmTimerFd, &alarmEventData, EPOLLIN) != 0) {
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &renderStatsStarted);
 	return 0;
 }
 
-int initializeButtonEpollTimer() {
-	if ((epollFd = CreateEpollFd()) < 0) {
-		Log_Debug("Error: Could not create Epoll file descriptor.\n");
+int armMinuteTimer() {
+	struct timespec currentTime;
+	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
+		Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
-	struct timespec buttonPressCheckPeriod = { 0, 1000000 };
-	if ((buttonPollTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &buttonPressCheckPeriod, &buttonEventData, EPOLLIN)) < 0) {
+
+	struct itimerspec nextMinute = { .it_value = { .tv_sec = (currentTime.tv_sec / 60 + 1) * 60, .tv_nsec = 0 } };
+	if (timerfd_settime(minuteTimerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &nextMinute, NULL) == -1) {
+		Log_Debug("Error: Could not set minute timerfd time: %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
+	return 0;
+}
 
-	struct timespec buzzerInterval = { 0, 100000000 };
-	if ((buzzerPollTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &buzzerInterval, &buzzerEventData, EPOLLIN)) < 0) {
+int armAlarmTimer(time_t alarmAt) {
+	struct itimerspec alarmValue = { .it_value = { .tv_sec = alarmAt, .tv_nsec = 0 } };
+	if (timerfd_settime(alarmTimerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &alarmValue, NULL) == -1) {
+		Log_Debug("Error: Could not set alarm timerfd time: %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
 	return 0;
@@ -235,6 +351,12 @@ int initializeI2C() {
 		return -1;
 	}
 
+	// The display still works at the speed initI2c set, so carry on at it
+	if (negotiateI2cSpeed(sd1306_ADDR) < 0) {
+		Log_Debug("Error: Could not negotiate I2C bus speed, keeping %u Hz.\n", getI2cBusSpeed());
+	}
+	Log_Debug("Info: I2C bus at %u Hz, %u bytes/s.\n", getI2cBusSpeed(), getI2cBytesPerSecond());
+
 	if (initializeDisplay() < 0) {
 		Log_Debug("Error: Could not initialize display.\n");
 		return -1;
@@ -244,13 +366,25 @@ int initializeI2C() {
 }
 
 int initializeDisplay() {
+	sd1306_set_backend(&sd1306_i2c_backend);
 	if (sd1306_init() != 0) {
 		Log_Debug("Error: could not init sd1306 %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
-	clear_oled_buffer();
-	sd1306_draw_string(0, 0, "Starting", 2, white_pixel);
+	sd1306_draw_packed_img(0, 0, splash_img, sizeof(splash_img));
 	sd1306_refresh();
+
+	sd1306_widget_init(&timeWidget, 0, 0, OLED_WIDTH, 32, 4, true);
+	sd1306_widget_init(&dateWidget, 0, 32, OLED_WIDTH, 16, 2, false);
+	sd1306_widget_init(&buzzzWidget, 0, 48, OLED_WIDTH, 16, 2, false);
+	sd1306_widget_set_text(&buzzzWidget, "buzzz");
+	sd1306_widget_init(&alarmStatusWidget, 0, 0, OLED_WIDTH, 16, 2, false);
+	sd1306_widget_init(&alarmTimeWidget, 0, 25, OLED_WIDTH, 24, 3, false);
+
+	// Keep the event loop responsive while frames are on the I2C bus
+	if (sd1306_start_flush_thread() != 0) {
+		Log_Debug("Warning: could not start display flush thread, refreshing synchronously.\n");
+	}
 	return 0;
 }
 
@@ -295,6 +429,14 @@ int initializeClock() {
 	return 0;
 }
 
+int applyTimeZone(void) {
+	if (setTimeZone() < 0) {
+		terminationRequired = true;
+		return -1;
+	}
+	return 0;
+}
+
 int setTimeZone() {
 	Log_Debug("Info: Setting time zone to %s\n", timezone);
 	if ((setenv("TZ", timezone, 1)) == -1) {
@@ -380,246 +522,171 @@ void setCurrentAlarm() {
 	Log_Debug("Alarm set to %02d:%02d %d/%d/%d\n", alarmTime.hour, alarmTime.minute, local.tm_mon + 1, local.tm_mday, local.tm_year + 1900);
 	Log_Debug("Alarm with offset (%d seconds) is %02d:%02d:%02d %d/%d/%d\n", alarmTime.offsetSeconds, local.tm_hour, local.tm_min, local.tm_sec, local.tm_mon + 1, local.tm_mday, local.tm_year + 1900);
 #endif // DEBUG
+	scheduleAlarm();
 }
 
 void terminationHandler(int signalNumber) {
 	terminationRequired = true;
 }
 
-void buttonTimerEventHandler(EventData* eventData)
-{
-	if (ConsumeTimerFdEvent(buttonPollTimerFd) != 0) {
-		terminationRequired = true;
-		return;
+int setButtonPollPeriod(bool fast) {
+	struct timespec period = { 0, (fast ? BUTTON_POLL_ACTIVE_MS : BUTTON_POLL_IDLE_MS) * 1000000 };
+	if (StartLogicalTimer(&timerWheel, &buttonPollTimer, &period, &period) != 0) {
+		return -1;
 	}
-
-	processButtonA();
-	processButtonB();
-	processButtonC();
-	processButtonSet();
+	buttonPollFast = fast;
+	return 0;
 }
 
-void buzzerTimerEventHandler(EventData* eventData)
-{
-	if (ConsumeTimerFdEvent(buzzerPollTimerFd) != 0) {
-		terminationRequired = true;
+// Fast while a button is settling or held down, slow again once they have all been up for a while
+void updateButtonPollRate(bool active) {
+	struct timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+
+	if (active) {
+		lastButtonActivity = currentTime;
+		if (!buttonPollFast && setButtonPollPeriod(true) != 0) {
+			terminationRequired = true;
+		}
 		return;
 	}
 
-	GPIO_Value_Type buzzerState;
-	if (GPIO_GetValue(buzzerFd, &buzzerState) != 0) {
-		Log_Debug("Error: Could not get buzzer state. %s (%d)", strerror(errno), errno);
+	long quietMs = (currentTime.tv_sec - lastButtonActivity.tv_sec) * 1000L + (currentTime.tv_nsec - lastButtonActivity.tv_nsec) / 1000000L;
+	if (buttonPollFast && quietMs >= BUTTON_POLL_QUIET_MS && setButtonPollPeriod(false) != 0) {
 		terminationRequired = true;
-		return;
 	}
+}
 
-	if (currentState == SoundAlarm) {
-		if (buzzerState == GPIO_Value_High) {
-			GPIO_SetValue(buzzerFd, GPIO_Value_Low);
-		}
-		else {
-			GPIO_SetValue(buzzerFd, GPIO_Value_High);
-		}
-	}
-	else if (currentState == Snooze) {
-		if (buzzerState == GPIO_Value_High) {
-			GPIO_SetValue(buzzerFd, GPIO_Value_Low);
-		}
-		struct timespec currentTime;
-		if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
-			Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
-			terminationRequired = true;
-			return;
-		}
-		if (currentTime.tv_sec > snoozeTime.tv_sec) {
-			currentState = SoundAlarm;
-		}
+void buttonTimerEventHandler(LogicalTimer* timer)
+{
+	buttonPollCount++;
+
+	bool active = false;
+	for (int i = 0; i < ButtonCount; i++) {
+		active |= pollButton(i);
 	}
-	else if (buzzerState == GPIO_Value_High) {
-		GPIO_SetValue(buzzerFd, GPIO_Value_Low);
+	updateButtonPollRate(active);
+}
+
+void renderTimerEventHandler(LogicalTimer* timer)
+{
+	renderTimerArmed = false;
+}
+
+void snoozeTimerEventHandler(LogicalTimer* timer)
+{
+	if (currentState == Snooze) {
+		currentState = SoundAlarm;
 	}
 }
 
-void processButtonA() {
-	GPIO_Value_Type newButtonState;
-	if (GPIO_GetValue(buttonAFd, &newButtonState) != 0) {
-		Log_Debug("Error: Could not get Button A state. %s (%d)", strerror(errno), errno);
+void minuteTimerEventHandler(EventData* eventData)
+{
+	uint64_t expirations;
+	// ECANCELED means the clock was set, the next minute moved with it and the face is out of date too
+	if (read(minuteTimerFd, &expirations, sizeof(expirations)) == -1 && errno != ECANCELED && errno != EAGAIN) {
+		Log_Debug("Error: Could not read minute timerfd: %s (%d).\n", strerror(errno), errno);
 		terminationRequired = true;
 		return;
 	}
-
-	if (newButtonState != buttonAState) {
-		if (currentState == Normal) {
-			if (newButtonState == GPIO_Value_Low) {
-				currentState = DisplayAlarm;
-			}
-		}
-		else if (currentState == DisplayAlarm) {
-			if (newButtonState == GPIO_Value_High) {
-				saveSettings();
-				currentState = Normal;
-			}
-		}
-		else if (currentState == SetSettings) {
-			if (newButtonState == GPIO_Value_Low) {
-				currentState = SetAlarmHour;
-			}
-		}
-		else if (currentState == SetAlarmHour) {
-			if (newButtonState == GPIO_Value_Low) {
-				alarmTime.hour = alarmTime.hour - 1;
-				if (alarmTime.hour > 23) {
-					alarmTime.hour = 23;
-				}
-			}
-		}
-		else if (currentState == SetAlarmMinute) {
-			if (newButtonState == GPIO_Value_Low) {
-				alarmTime.minute = alarmTime.minute - 1;
-				if (alarmTime.hour > 59) {
-					alarmTime.hour = 59;
-				}
-			}
-		}
-		else if (currentState == SetTimeZone) {
-			if (newButtonState == GPIO_Value_Low) {
-				timezone[0] = (timezone[0] == '+' ? '-' : '+');
-			}
-		}
-		else if (currentState == SoundAlarm || currentState == Snooze) {
-			processAlarmButtonPress(ButtonA);
-		}
-
-		buttonAState = newButtonState;
+	if (armMinuteTimer() < 0) {
+		terminationRequired = true;
+		return;
 	}
+	requestRender();
 }
-void processButtonB() {
-	GPIO_Value_Type newButtonState;
-	if (GPIO_GetValue(buttonBFd, &newButtonState) != 0) {
-		Log_Debug("Error: Could not get Button A state. %s (%d)", strerror(errno), errno);
+
+// True when the clock is synced and the alarm deadline is now at or behind it, by less than a day
+bool alarmPassedOnSyncedClock(void) {
+	struct timespec currentTime;
+	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
+		Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
 		terminationRequired = true;
-		return;
+		return false;
 	}
+	return currentTime.tv_sec > INVALID_DATE_TIME
+		&& alarmTime.currentAlarmTime <= currentTime.tv_sec
+		&& currentTime.tv_sec - alarmTime.currentAlarmTime < SECONDS_IN_DAY;
+}
 
-	if (newButtonState != buttonBState) {
-		if (currentState == SetAlarmHour) {
-			if (newButtonState == GPIO_Value_Low) {
-				alarmTime.hour = (alarmTime.hour + 1) % 24;
-			}
-		}
-		else if (currentState == SetAlarmMinute) {
-			if (newButtonState == GPIO_Value_Low) {
-				alarmTime.minute = (alarmTime.minute + 1) % 60;
+void alarmTimerEventHandler(EventData* eventData)
+{
+	uint64_t expirations;
+	if (read(alarmTimerFd, &expirations, sizeof(expirations)) == -1) {
+		// ECANCELED means the clock was set. A step forward across the alarm still sounds it, late,
+		// otherwise the alarm may have been worked out against an unsynced clock so work it out again
+		if (errno == ECANCELED) {
+			if (!alarmPassedOnSyncedClock()) {
+				setCurrentAlarm();
+				return;
 			}
 		}
-		else if (currentState == SetTimeZone) {
-			if (newButtonState == GPIO_Value_Low) {
-				char* hourString = &timezone[1];
-				int hours = atoi(hourString);
-				hours = hours - 1;
-				if (hours < 0) {
-					hours = 23;
-				}
-				sprintf(hourString, "%02d", hours);
-			}
+		else if (errno != EAGAIN) {
+			Log_Debug("Error: Could not read alarm timerfd: %s (%d).\n", strerror(errno), errno);
+			terminationRequired = true;
+			return;
 		}
-
-		buttonBState = newButtonState;
-	}
-}
-void processButtonC() {
-	GPIO_Value_Type newButtonState;
-	if (GPIO_GetValue(buttonCFd, &newButtonState) != 0) {
-		Log_Debug("Error: Could not get Button A state. %s (%d)", strerror(errno), errno);
-		terminationRequired = true;
-		return;
 	}
 
-	if (newButtonState != buttonCState) {
-		if (currentState == SetSettings) {
-			if (newButtonState == GPIO_Value_Low) {
-				currentState = SetTimeZone;
-			}
-		}
-		else if (currentState == DisplayAlarm) {
-			if (newButtonState == GPIO_Value_Low) {
-				alarmTime.active = !alarmTime.active;
-			}
+	// Settings screens hold the alarm off until they close, as checking only in Normal always did
+	if (currentState != Normal) {
+		struct timespec currentTime;
+		if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
+			Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
+			terminationRequired = true;
+			return;
 		}
-		else if (currentState == SetTimeZone) {
-			if (newButtonState == GPIO_Value_Low) {
-				char* hourString = &timezone[1];
-				int hours = atoi(hourString);
-				hours = (hours + 1) % 24;
-				sprintf(hourString, "%02d", hours);
-			}
+		if (armAlarmTimer(currentTime.tv_sec + 1) < 0) {
+			terminationRequired = true;
 		}
-
-		buttonCState = newButtonState;
+		return;
 	}
+	checkAlarm();
 }
-void processButtonSet() {
-	GPIO_Value_Type newButtonState;
-	if (GPIO_GetValue(buttonSetFd, &newButtonState) != 0) {
-		Log_Debug("Error: Could not get Button A state. %s (%d)", strerror(errno), errno);
+
+void buzzerTimerEventHandler(LogicalTimer* timer)
+{
+	GPIO_Value_Type buzzerState;
+	if (GPIO_GetValue(buzzerFd, &buzzerState) != 0) {
+		Log_Debug("Error: Could not get buzzer state. %s (%d)", strerror(errno), errno);
 		terminationRequired = true;
 		return;
 	}
 
-	if (newButtonState != buttonSetState) {
-		if (currentState == Normal) {
-			if (newButtonState == GPIO_Value_Low) {
-				currentState = SetSettings;
-			}
-		}
-		else if (currentState == SetAlarmHour) {
-			if (newButtonState == GPIO_Value_High) {
-				currentState = SetAlarmMinute;
-			}
-		}
-		else if (currentState == SetAlarmMinute) {
-			if (newButtonState == GPIO_Value_High) {
-				alarmTime.offsetSeconds = 0;
-				saveSettings();
-				setCurrentAlarm();
-				currentState = Normal;
-			}
-		} 
-		else if (currentState == SetTimeZone) {
-			if (newButtonState == GPIO_Value_High) {
-				if (setTimeZone() < 0) {
-					terminationRequired = true;
-					return;
-				}
-				saveSettings();
-				currentState = Normal;
-			}
+	if (currentState == SoundAlarm) {
+		if (buzzerState == GPIO_Value_High) {
+			GPIO_SetValue(buzzerFd, GPIO_Value_Low);
 		}
-		else if (currentState == SoundAlarm) {
-			processAlarmButtonPress(ButtonSet);
+		else {
+			GPIO_SetValue(buzzerFd, GPIO_Value_High);
 		}
-
-		buttonSetState = newButtonState;
+	}
+	else if (buzzerState == GPIO_Value_High) {
+		GPIO_SetValue(buzzerFd, GPIO_Value_Low);
 	}
 }
 
-void processAlarmButtonPress(enum buttonName button) {
-	if (button == ButtonA) {
-		endSoundAlarm();
+// Samples a button, true while it is settling or held down
+bool pollButton(enum buttonName button) {
+	Button* b = &buttons[button];
+	GPIO_Value_Type level;
+	if (GPIO_GetValue(b->fd, &level) != 0) {
+		Log_Debug("Error: Could not get %s state. %s (%d)", b->name, strerror(errno), errno);
+		terminationRequired = true;
+		return false;
 	}
-	else if (button == ButtonSet) {
-		currentState = Snooze;
-		if (clock_gettime(CLOCK_REALTIME, &snoozeTime) == -1) {
-			Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
-			terminationRequired = true;
-			return;
-		}
-		snoozeTime.tv_sec += SNOOZE_LENGTH;
+	return sampleButton(button, level == GPIO_Value_Low);
+}
+
+void startSnooze(void) {
+	struct timespec snoozeLength = { SNOOZE_LENGTH, 0 };
+	if (StartLogicalTimer(&timerWheel, &snoozeTimer, &snoozeLength, NULL) != 0) {
+		terminationRequired = true;
 	}
 }
 
 void endSoundAlarm() {
-	currentState = Normal;
+	StopLogicalTimer(&timerWheel, &snoozeTimer);
 	GPIO_SetValue(buzzerFd, GPIO_Value_Low);
 	struct timespec currentTime;
 	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
@@ -669,61 +736,57 @@ void debugTime() {
 
 
 
+void composeWidgets(struct sd1306_widget* const* widgets, uint8_t count) {
+	sd1306_compose(widgets, count, widgets != composedWidgets);
+	composedWidgets = widgets;
+}
+
 void displayAlarm() {
 	char buffer[10];
 	char* active = (alarmTime.active ? "On" : "Off");
-	clear_oled_buffer();
 	sprintf(buffer, "Alarm %s", active);
-	sd1306_draw_string(0, 0, buffer, 2, white_pixel);
+	sd1306_widget_set_text(&alarmStatusWidget, buffer);
 	sprintf(buffer, "%02d:%02d", alarmTime.hour, alarmTime.minute);
-	sd1306_draw_string(0, 25, buffer, 3, white_pixel);
+	sd1306_widget_set_text(&alarmTimeWidget, buffer);
+	composeWidgets(alarmWidgets, sizeof(alarmWidgets) / sizeof(alarmWidgets[0]));
 	sd1306_refresh();
 }
 
-void displayTime() {
+void displayClock(bool buzzz) {
 	struct timespec currentTime;
 	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
 		Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
 		terminationRequired = true;
 		return;
 	}
-	else {
+
+	// check to make sure sync'd up with an NTP server since the default date would be 1/1/1900
+	if (currentTime.tv_sec < INVALID_DATE_TIME) {
 		clear_oled_buffer();
-		struct tm local = *localtime(&currentTime.tv_sec);
-		// check to make sure sync'd up with an NTP server since the default date would be 1/1/1900
-		if (currentTime.tv_sec < INVALID_DATE_TIME) {
-			sd1306_draw_string(0, 0, "Syncing", 3, white_pixel);
-		}
-		else {
-			char buffer[11] = { 0 };
-			sprintf(buffer, "%02d:%02d", local.tm_hour, local.tm_min);
-			sd1306_draw_string(0, 0, buffer, 4, white_pixel);
-			sprintf(buffer, "%d/%d/%d", local.tm_mon + 1, local.tm_mday, local.tm_year + 1900);
-			sd1306_draw_string(0, 35, buffer, 2, white_pixel);
-		}
+		sd1306_draw_string(0, 0, "Syncing", 3, white_pixel);
+		composedWidgets = NULL;
 		sd1306_refresh();
+		return;
 	}
 
+	char buffer[11] = { 0 };
+	struct tm local = *localtime(&currentTime.tv_sec);
+	sprintf(buffer, "%02d:%02d", local.tm_hour, local.tm_min);
+	sd1306_widget_set_text(&timeWidget, buffer);
+	sprintf(buffer, "%d/%d/%d", local.tm_mon + 1, local.tm_mday, local.tm_year + 1900);
+	sd1306_widget_set_text(&dateWidget, buffer);
+	// Pages 6 and 7 only hold the ticker so scrolling them does not move the date
+	sd1306_widget_set_visible(&buzzzWidget, buzzz);
+	composeWidgets(clockWidgets, sizeof(clockWidgets) / sizeof(clockWidgets[0]));
+	sd1306_refresh();
+}
+
+void displayTime() {
+	displayClock(false);
 }
 
 void displaySoundAlarm() {
-	struct timespec currentTime;
-	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
-		Log_Debug("Error: clock_getTime failed with error code: %s (%d).\n", strerror(errno), errno);
-		terminationRequired = true;
-		return;
-	}
-	else {
-		char buffer[11] = { 0 };
-		struct tm local = *localtime(&currentTime.tv_sec);
-		clear_oled_buffer();
-		sprintf(buffer, "%02d:%02d", local.tm_hour, local.tm_min);
-		sd1306_draw_string(0, 0, buffer, 4, white_pixel);
-		sprintf(buffer, "%d/%d/%d", local.tm_mon + 1, local.tm_mday, local.tm_year + 1900);
-		sd1306_draw_string(0, 35, buffer, 2, white_pixel);
-		sd1306_draw_string(0, 50, "buzzz", 2, white_pixel);
-		sd1306_refresh();
-	}
+	displayClock(true);
 }
 
 void displaySetSettings() {
@@ -758,6 +821,96 @@ void displaySetTimeZone() {
 	sd1306_refresh();
 }
 
+void requestRender(void) {
+	renderRequested = true;
+}
+
+void render() {
+	if (currentState == Normal) {
+		displayTime();
+	}
+	else if (currentState == SoundAlarm || currentState == Snooze) {
+		displaySoundAlarm();
+	}
+	else if (currentState == DisplayAlarm) {
+		displayAlarm();
+	}
+	else if (currentState == SetSettings) {
+		displaySetSettings();
+	}
+	else if (currentState == SetAlarmHour) {
+		displaySetAlarmHour();
+	}
+	else if (currentState == SetAlarmMinute) {
+		displaySetAlarmMinute();
+	}
+	else if (currentState == SetTimeZone) {
+		displaySetTimeZone();
+	}
+}
+
+void renderIfDue() {
+	if (!renderRequested) {
+		return;
+	}
+
+	struct timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	long frameIntervalNs = 1000000000L / maxFramesPerSecond[currentState];
+	long sinceLastRenderNs = (currentTime.tv_sec - lastRender.tv_sec) * 1000000000L + (currentTime.tv_nsec - lastRender.tv_nsec);
+	if (sinceLastRenderNs >= 0 && sinceLastRenderNs < frameIntervalNs) {
+		// Too soon, the render timer wakes the loop up when the frame is due
+		if (!renderTimerArmed) {
+			struct timespec wait = { 0, frameIntervalNs - sinceLastRenderNs };
+			if (StartLogicalTimer(&timerWheel, &renderTimer, &wait, NULL) != 0) {
+				terminationRequired = true;
+				return;
+			}
+			renderTimerArmed = true;
+		}
+		return;
+	}
+
+	renderRequested = false;
+	lastRender = currentTime;
+	renderCount++;
+	render();
+}
+
+void updateRenderStats() {
+	struct timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	time_t elapsed = currentTime.tv_sec - renderStatsStarted.tv_sec;
+	if (elapsed < RENDER_STATS_PERIOD) {
+		return;
+	}
+#ifdef DEBUG
+	Log_Debug("Info: %.1f wakeups/s, %.1f events/s, %.1f button polls/s, %.2f renders/s.\n", (double)wakeupCount / elapsed,
+		(double)eventCount / elapsed, (double)buttonPollCount / elapsed, (double)renderCount / elapsed);
+#endif // DEBUG
+	wakeupCount = 0;
+	eventCount = 0;
+	renderCount = 0;
+	buttonPollCount = 0;
+	renderStatsStarted = currentTime;
+}
+
+void updateDisplayEffects(enum runningState from, enum runningState to) {
+	bool fromAlarm = (from == SoundAlarm || from == Snooze);
+	bool toAlarm = (to == SoundAlarm || to == Snooze);
+
+	if (toAlarm && !fromAlarm) {
+		sd1306_start_scroll(scroll_left, 6, 7, scroll_5_frames);
+	}
+	else if (fromAlarm && !toAlarm) {
+		sd1306_stop_scroll();
+	}
+
+	if ((from == Normal && to == DisplayAlarm) || (from == DisplayAlarm && to == Normal)) {
+		sd1306_slide_next_refresh(SLIDE_STEP_MS);
+	}
+}
+
 void checkAlarm() {
 	struct timespec currentTime;
 	if (clock_gettime(CLOCK_REALTIME, &currentTime) == -1) {
@@ -766,26 +919,58 @@ void checkAlarm() {
 		return;
 	}
 
-	if (alarmTime.currentAlarmTime < currentTime.tv_sec) {
+	if (alarmTime.currentAlarmTime <= currentTime.tv_sec) {
 		soundAlarmStarted = currentTime;
 		if(alarmTime.active){
 			currentState = SoundAlarm;
 		}
 		alarmTime.currentAlarmTime += SECONDS_IN_DAY;
 	}
+	scheduleAlarm();
+}
+
+// Wakes up checkAlarm right at the alarm time, offset included, a time already passed wakes it straight away
+void scheduleAlarm() {
+	if (armAlarmTimer(alarmTime.currentAlarmTime) < 0) {
+		terminationRequired = true;
+	}
+}
+
+// Runs once per wakeup after every ready event was handled, so timers firing together render once
+void afterEvents(void) {
+	wakeupCount++;
+
+	// Scroll and slide effects go out with the first frame of the new state
+	if (currentState != displayedState) {
+		updateDisplayEffects(displayedState, currentState);
+		displayedState = currentState;
+		composedWidgets = NULL;
+		requestRender();
+	}
+
+	renderIfDue();
+	updateRenderStats();
+
+#if (defined(IOT_CENTRAL_APPLICATION))
+	// AzureIoT_DoPeriodicTasks() needs to be called frequently in order to keep active
+	// the flow of data with the Azure IoT Hub
+	AzureIoT_DoPeriodicTasks();
+#endif
 }
 
 void closePeripheralsAndHandlers(void)
 {
 	Log_Debug("Closing file descriptors.\n");
 
+	sd1306_stop_flush_thread();
 	closeI2c();
-	CloseFdAndPrintError(buttonAFd, "Button A");
-	CloseFdAndPrintError(buttonBFd, "Button B");
-	CloseFdAndPrintError(buttonCFd, "Button C");
-	CloseFdAndPrintError(buttonSetFd, "Button Set");
-	CloseFdAndPrintError(buttonPollTimerFd, "Button Poll Timer");
+	for (int i = 0; i < ButtonCount; i++) {
+		CloseFdAndPrintError(buttons[i].fd, buttons[i].name);
+	}
 	CloseFdAndPrintError(buzzerFd, "Buzzer");
+	CloseFdAndPrintError(timerWheel.eventData.fd, "Timer Wheel");
+	CloseFdAndPrintError(minuteTimerFd, "Minute Timer");
+	CloseFdAndPrintError(alarmTimerFd, "Alarm Timer");
 	CloseFdAndPrintError(epollFd, "epoll");
 }
 
@@ -810,6 +995,13 @@ int main(int argc, char* argv[]) {
 	debugTime();
 #endif // DEBUG
 
+#ifdef SD1306_BENCHMARK
+	sd1306_benchmark_run();
+	if (sd1306_start_flush_thread() != 0) {
+		Log_Debug("Warning: could not restart display flush thread, refreshing synchronously.\n");
+	}
+#endif // SD1306_BENCHMARK
+
 	while (!terminationRequired) {
 
 #if (defined(IOT_CENTRAL_APPLICATION))
@@ -823,40 +1015,21 @@ int main(int argc, char* argv[]) {
 		}
 #endif 
 
-		if (WaitForEventAndCallHandler(epollFd) != 0) {
+		int eventsHandled = WaitForEventsAndCallHandlers(epollFd, &afterEvents);
+		if (eventsHandled < 0) {
 			terminationRequired = true;
 		}
-
-		if (currentState == Normal) {
-			displayTime();
-			checkAlarm();
-		}
-		else if (currentState == SoundAlarm || currentState == Snooze) {
-			displaySoundAlarm();
-		}
-		else if (currentState == DisplayAlarm) {
-			displayAlarm();
-		}
-		else if (currentState == SetSettings) {
-			displaySetSettings();
-		}
-		else if (currentState == SetAlarmHour) {
-			displaySetAlarmHour();
-		}
-		else if (currentState == SetAlarmMinute) {
-			displaySetAlarmMinute();
-		}
-		else if (currentState == SetTimeZone) {
-			displaySetTimeZone();
+		else {
+			eventCount += eventsHandled;
 		}
-
-#if (defined(IOT_CENTRAL_APPLICATION))
-		// AzureIoT_DoPeriodicTasks() needs to be called frequently in order to keep active
-		// the flow of data with the Azure IoT Hub
-		AzureIoT_DoPeriodicTasks();
-#endif
 	}
 	Log_Debug("Info: Application exiting.\n");
+#ifdef DEBUG
+	struct sd1306_stats displayStats;
+	sd1306_get_stats(&displayStats);
+	Log_Debug("Info: Display frames sent %u, skipped %u, %u bytes sent.\n", displayStats.frames_sent, displayStats.frames_skipped, displayStats.bytes_sent);
+	Log_Debug("Info: Display frame latency min %u us, avg %u us, max %u us.\n", displayStats.latency_min_us, displayStats.latency_avg_us, displayStats.latency_max_us);
+#endif // DEBUG
 	closePeripheralsAndHandlers();
 	return 0;
 }
\ No newline at end of file
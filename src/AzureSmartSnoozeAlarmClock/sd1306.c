@@ -5,31 +5,168 @@
 
 #include "sd1306.h"
 #include "font.h"
+#include "font_atlas.h"
+#include "sd1306_kernels.h"
 
-// pixel data of OLED screen
-uint8_t oled_buffer[BUFFER_SIZE];
-
-// Lock up table to reverse byte's bits 
-static const uint8_t BitReverseTable256[] =
-{
-	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
-	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
-	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
-	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
-	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
-	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
-	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
-	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
-	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
-	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
-	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
-	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
-	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
-	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
-	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
-	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+// Room for the I2C control byte in front of the pixel data, so a refresh can send straight from
+// the buffer. The room is a whole word to keep the pixel data word aligned.
+#define OLED_FRAME_PREFIX sizeof(uint32_t)
+
+// A hardware scroll as sent to the controller
+struct sd1306_scroll
+{
+	// Scroll setup and activation commands, no scroll when length is zero
+	uint8_t commands[12];
+	uint8_t length;
+	// Pages whose RAM content the scroll moves
+	uint8_t first_page;
+	uint8_t last_page;
+};
+
+// Controller changes that go out with a frame
+struct sd1306_effects
+{
+	// Scroll to run once the frame is in OLED RAM, when scroll_changed is set
+	struct sd1306_scroll scroll;
+	uint8_t scroll_changed;
+	// Slide the frame in from the bottom a page every slide_step_ms, when not zero
+	uint32_t slide_step_ms;
+};
+
+// A frame on its way to OLED RAM, pixel data is preceded by OLED_FRAME_PREFIX bytes of room
+struct sd1306_frame
+{
+	uint8_t* pixels;
+	// Changed columns of each page, empty when first > last
+	uint8_t first_col[OLED_PAGES];
+	uint8_t last_col[OLED_PAGES];
+	// When the oldest change in the frame was handed over
+	struct timespec presented;
+	struct sd1306_effects effects;
+};
+
+// A frame being sent by sd1306_flush_begin, sd1306_flush_next and sd1306_flush_end
+struct sd1306_flush_job
+{
+	struct sd1306_display* panel;
+	uint8_t* pixels;
+	uint8_t* dirty_first;
+	uint8_t* dirty_last;
+	struct timespec presented;
+	// Next page to look for a changed window in
+	uint8_t page;
+	uint8_t sent;
+	uint8_t start_scroll;
+	uint32_t bytes_sent;
+	// Scroll to start once the frame is in OLED RAM
+	struct sd1306_scroll resume;
+};
+
+// A panel on the bus, its OLED buffer and what is known about its OLED RAM
+struct sd1306_display
+{
+	// OLED buffer, pixel data preceded by OLED_FRAME_PREFIX bytes of room
+	uint8_t frame[OLED_FRAME_PREFIX + BUFFER_SIZE] __attribute__((aligned(4)));
+	// With the flush thread running, sd1306_refresh copies OLED buffer into the ready frame and
+	// returns. The flush thread swaps the ready frame with the front frame and sends the front frame.
+	uint8_t flush_frames[2][OLED_FRAME_PREFIX + BUFFER_SIZE] __attribute__((aligned(4)));
+	struct sd1306_frame ready_frame;
+	struct sd1306_frame front_frame;
+	uint8_t ready_pending;
+	// Copy of what was last written to OLED RAM, refresh only sends bytes that differ from it
+	uint8_t shadow_buffer[BUFFER_SIZE];
+	// Bit n set when page n of shadow_buffer matches OLED RAM
+	uint8_t shadow_valid_pages;
+	// Set when OLED RAM stopped matching shadow_buffer, next flush drops the shadow
+	uint8_t shadow_reset;
+	uint8_t addr;
+	// A sd1306_orientation, applied by sd1306_init
+	uint8_t orientation;
+	uint8_t open;
+	// First and last column of each page changed since the last refresh (empty when first > last).
+	// Everything starts out dirty so the first refresh writes the whole OLED RAM.
+	uint8_t dirty_first_col[OLED_PAGES];
+	uint8_t dirty_last_col[OLED_PAGES];
+	// Refresh counters
+	struct sd1306_stats refresh_stats;
+	// Sum of the latencies behind refresh_stats.latency_avg_us
+	uint64_t latency_total_us;
+	// Effects requested since the last refresh, they go out with the next one
+	struct sd1306_effects pending_effects;
+	// Scroll the controller is running, only touched by whoever flushes
+	struct sd1306_scroll scroll_running;
+	// Clip rectangle, inclusive bounds, nothing is drawn outside of it (empty when x0 > x1)
+	int32_t clip_x0;
+	int32_t clip_y0;
+	int32_t clip_x1;
+	int32_t clip_y1;
+	// Rows of each page inside the clip rectangle
+	uint8_t clip_page_mask[OLED_PAGES];
+};
+
+// Panels that can be open, the first one is the panel at sd1306_ADDR
+static struct sd1306_display displays[SD1306_MAX_DISPLAYS] =
+{
+	[0] =
+	{
+		.addr = sd1306_ADDR,
+		.orientation = orientation_upside_up,
+		.open = 1,
+		.dirty_last_col = { OLED_WIDTH - 1, OLED_WIDTH - 1, OLED_WIDTH - 1, OLED_WIDTH - 1,
+			OLED_WIDTH - 1, OLED_WIDTH - 1, OLED_WIDTH - 1, OLED_WIDTH - 1 },
+		.clip_x1 = OLED_WIDTH - 1,
+		.clip_y1 = OLED_HEIGHT - 1,
+		.clip_page_mask = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	},
 };
 
+// Panel that drawing, refreshes and effects act on
+static struct sd1306_display* display = &displays[0];
+
+// pixel data of the selected panel
+uint8_t* oled_buffer = &displays[0].frame[OLED_FRAME_PREFIX];
+
+// Serializes I2C transactions, a window command and its data must not be split by other commands
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// One flush thread sends the frames of every panel
+static uint8_t flush_stop;
+static uint8_t flush_running;
+static pthread_t flush_thread;
+// Guards the ready frames, ready_pending, flush_stop, shadow_reset and the refresh counters of all panels
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+
+// Where transfers to the panel go, none until sd1306_set_backend
+static const struct sd1306_backend* backend;
+
+/**
+  * @brief  Choose where transfers to the panel go.
+  * @param  new_backend: backend to use, it must stay valid while in use
+  * @retval None.
+  * @note   Call before sd1306_init and while the flush thread is stopped.
+  */
+void sd1306_set_backend(const struct sd1306_backend* new_backend)
+{
+	backend = new_backend;
+}
+
+/**
+  * @brief  Send a transfer to the panel through the backend.
+  * @param  addr: address of device
+  * @param  bytes: control byte and payload
+  * @param  length: number of bytes in bytes
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  */
+static int32_t sd1306_transfer(uint8_t addr, const uint8_t* bytes, uint16_t length)
+{
+	if (backend == NULL)
+	{
+		return -1;
+	}
+	return backend->write(backend->context, addr, bytes, length);
+}
+
 /**
   * @brief  Send command to sd1306.
   * @param  addr: address of device
@@ -45,346 +182,741 @@ int32_t sd1306_send_command(uint8_t addr, uint8_t cmd)
 	// Commando to send
 	data_to_send[1] = cmd;
 	// Send the data by I2C bus
-	retval = I2CMaster_Write(i2cFd, addr, data_to_send, 2);
+	pthread_mutex_lock(&bus_lock);
+	retval = sd1306_transfer(addr, data_to_send, 2);
+	pthread_mutex_unlock(&bus_lock);
 	return retval;
 }
 
 /**
-  * @brief  Send data to sd1306 RAM.
+  * @brief  Send a sequence of commands to sd1306 in one I2C transaction, bus_lock must be held.
   * @param  addr: address of device
-  * @param  data: pointer to data
+  * @param  cmds: commands and their arguments
+  * @param  count: number of bytes in cmds, at most SD1306_MAX_COMMAND_LIST
   * @retval retval: negative if was unsuccefully, positive if was succefully
   */
-int32_t sd1306_write_data(uint8_t addr, uint8_t* data)
+static int32_t sd1306_write_command_list(uint8_t addr, const uint8_t* cmds, uint8_t count)
 {
-	int32_t retval;
-	uint16_t i;
-	uint8_t data_to_send[1025];
-	// Byte to tell sd1306 to process byte as data
-	data_to_send[0] = 0x40;
+	uint8_t data_to_send[SD1306_MAX_COMMAND_LIST + 1];
 
-	// Copy data to buffer
-	for (i = 0; i < 1024; i++)
+	if (count > SD1306_MAX_COMMAND_LIST)
 	{
-		data_to_send[i + 1] = data[i];
+		return -1;
 	}
 
+	// Byte to tell sd1306 to process every following byte as command (continuation bit clear)
+	data_to_send[0] = 0x00;
+	memcpy(&data_to_send[1], cmds, count);
+
+	// Send the data by I2C bus
+	return sd1306_transfer(addr, data_to_send, count + 1);
+}
+
+/**
+  * @brief  Send data to sd1306 RAM in place, bus_lock must be held.
+  * @param  addr: address of device
+  * @param  data: pointer to data, the byte before it is borrowed for the control byte
+  * @param  length: number of bytes to send
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  */
+static int32_t sd1306_write_data_in_place(uint8_t addr, uint8_t* data, uint16_t length)
+{
+	int32_t retval;
+	uint8_t saved = data[-1];
+
+	// Byte to tell sd1306 to process byte as data
+	data[-1] = 0x40;
+
 	// Send the data by I2C bus
-	retval = I2CMaster_Write(i2cFd, addr, data_to_send, 1025);
+	retval = sd1306_transfer(addr, &data[-1], length + 1);
+
+	data[-1] = saved;
 	return retval;
 }
 
 /**
-  * @brief  Initialize sd1306.
-  * @param  None.
-  * @retval Positive if was unsuccefully, zero if was succefully.
+  * @brief  Send a sequence of commands to sd1306 in one I2C transaction.
+  * @param  addr: address of device
+  * @param  cmds: commands and their arguments
+  * @param  count: number of bytes in cmds, at most SD1306_MAX_COMMAND_LIST
+  * @retval retval: negative if was unsuccefully, positive if was succefully
   */
-uint8_t sd1306_init(void)
+int32_t sd1306_send_command_list(uint8_t addr, const uint8_t* cmds, uint8_t count)
+{
+	int32_t retval;
+
+	pthread_mutex_lock(&bus_lock);
+	retval = sd1306_write_command_list(addr, cmds, count);
+	pthread_mutex_unlock(&bus_lock);
+	return retval;
+}
+
+/**
+  * @brief  Send data to sd1306 RAM.
+  * @param  addr: address of device
+  * @param  data: pointer to data, the byte before it is borrowed for the control byte
+  * @param  length: number of bytes to send
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  * @note   Data is sent in place without copying. Any window of a frame qualifies since the
+  *         byte before it is either pixel data, restored afterwards, or the room in front of it.
+  */
+int32_t sd1306_write_data(uint8_t addr, uint8_t* data, uint16_t length)
+{
+	int32_t retval;
+
+	pthread_mutex_lock(&bus_lock);
+	retval = sd1306_write_data_in_place(addr, data, length);
+	pthread_mutex_unlock(&bus_lock);
+	return retval;
+}
+
+/**
+  * @brief  Send a window of a frame to the same window of sd1306 RAM.
+  * @param  panel: panel to send to
+  * @param  pixels: frame to send from
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  * @note   Window must be full width when it spans more than one page, so its data is contiguous.
+  */
+static int32_t sd1306_write_window(struct sd1306_display* panel, uint8_t* pixels, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col)
 {
-	// OLED turn off and check if OLED is connected
-	if (sd1306_send_command(sd1306_ADDR, 0xae) < 0)
+	int32_t retval = -1;
+	const uint8_t window_commands[] =
 	{
-		return 1;
+		// Set column address, start column, last column
+		0x21, first_col, last_col,
+		// Set page address, start page, last page
+		0x22, first_page, last_page,
+	};
+
+	pthread_mutex_lock(&bus_lock);
+	if (sd1306_write_command_list(panel->addr, window_commands, sizeof(window_commands)) >= 0)
+	{
+		// Horizontal addressing mode wraps the RAM pointer inside the window
+		retval = sd1306_write_data_in_place(panel->addr, &pixels[first_col + first_page * OLED_WIDTH],
+			(last_page - first_page + 1) * (last_col - first_col + 1));
 	}
-	// Set display oscillator freqeuncy and divide ratio
-	sd1306_send_command(sd1306_ADDR, 0xd5);
-	sd1306_send_command(sd1306_ADDR, 0x50);
-
-	// Set multiplex ratio
-	sd1306_send_command(sd1306_ADDR, 0xa8);
-	sd1306_send_command(sd1306_ADDR, 0x3f);
-	// Set display start line
-	sd1306_send_command(sd1306_ADDR, 0xd3);
-	sd1306_send_command(sd1306_ADDR, 0x00);
-	// Set the lower comulmn address
-	sd1306_send_command(sd1306_ADDR, 0x00);
-	// Set the higher comulmn address
-	sd1306_send_command(sd1306_ADDR, 0x10);
-
-	// Set page address
-	sd1306_send_command(sd1306_ADDR, 0xb0);
-
-	// Charge pump
-	sd1306_send_command(sd1306_ADDR, 0x8d);
-	sd1306_send_command(sd1306_ADDR, 0x14);
-
-	// Memory mode
-	sd1306_send_command(sd1306_ADDR, 0x20);
-	sd1306_send_command(sd1306_ADDR, 0x00);
-
-	// Set segment from left to right
-	sd1306_send_command(sd1306_ADDR, 0xa0 | 0x01);
-	// Set OLED upside up
-	sd1306_send_command(sd1306_ADDR, 0xc8);
-	// Set common signal pad configuration
-	sd1306_send_command(sd1306_ADDR, 0xda);
-	sd1306_send_command(sd1306_ADDR, 0x12);
-
-	// Set Contrast
-	sd1306_send_command(sd1306_ADDR, 0x81);
-	// Contrast data
-	sd1306_send_command(sd1306_ADDR, 0x00);
-
-	// Set discharge precharge periods
-	sd1306_send_command(sd1306_ADDR, 0xd9);
-	sd1306_send_command(sd1306_ADDR, 0xf1);
-
-	// Set common mode pad output voltage 
-	sd1306_send_command(sd1306_ADDR, 0xdb);
-	sd1306_send_command(sd1306_ADDR, 0x40);
-
-	// Set Enire display
-	sd1306_send_command(sd1306_ADDR, 0xa4);
-
-	// Set Normal display
-	sd1306_send_command(sd1306_ADDR, 0xa6);
-	// Stop scroll
-	sd1306_send_command(sd1306_ADDR, 0x2e);
-
-	// OLED turn on
-	sd1306_send_command(sd1306_ADDR, 0xaf);
-
-	// Set column address
-	sd1306_send_command(sd1306_ADDR, 0x21);
-	// Start Column
-	sd1306_send_command(sd1306_ADDR, 0x00);
-	// Last column
-	sd1306_send_command(sd1306_ADDR, 127);
-
-	// Set page address
-	sd1306_send_command(sd1306_ADDR, 0x22);
-	// Start Page
-	sd1306_send_command(sd1306_ADDR, 0x00);
-	// Last Page
-	sd1306_send_command(sd1306_ADDR, 0x07);
+	pthread_mutex_unlock(&bus_lock);
+	return retval;
+}
 
-	return 0;
+/**
+  * @brief  Find the first column of a page row that differs from the shadow.
+  * @param  panel: panel whose shadow to compare with
+  * @param  pixels: frame to compare
+  * @param  page: page to compare
+  * @param  first: first column to compare
+  * @param  last: last column to compare
+  * @retval Column of the first difference, last + 1 if there is none.
+  */
+static int32_t sd1306_first_change(const struct sd1306_display* panel, const uint8_t* pixels, uint8_t page, int32_t first, int32_t last)
+{
+	uint32_t offset = first + page * OLED_WIDTH;
+
+	if (first > last)
+	{
+		return first;
+	}
+	return first + sd1306_kernel_first_diff(&pixels[offset], &panel->shadow_buffer[offset], last - first + 1);
 }
 
 /**
-  * @brief  Draw a pixel at specified coordinates
-  * @param  x: x coordinate
-  * @param  y: y coordinate
+  * @brief  Find the last column of a page row that differs from the shadow.
+  * @param  panel: panel whose shadow to compare with
+  * @param  pixels: frame to compare
+  * @param  page: page to compare
+  * @param  first: first column to compare
+  * @param  last: last column to compare
+  * @retval Column of the last difference, first - 1 if there is none.
+  */
+static int32_t sd1306_last_change(const struct sd1306_display* panel, const uint8_t* pixels, uint8_t page, int32_t first, int32_t last)
+{
+	uint32_t offset = first + page * OLED_WIDTH;
+
+	if (first > last)
+	{
+		return last;
+	}
+	return first + sd1306_kernel_last_diff(&pixels[offset], &panel->shadow_buffer[offset], last - first + 1) - 1;
+}
+
+/**
+  * @brief  Mark a rectangle of OLED buffer as changed.
+  * @param  x0: left column
+  * @param  y0: top row
+  * @param  x1: right column
+  * @param  y1: bottom row
   * @retval None.
   */
-void sd1306_draw_pixel(int32_t x, int32_t y, uint8_t color)
+static void sd1306_mark_dirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
 {
-	// Verify that pixel is inside of OLED matrix
-	if (x >= 0 && x < 128 && y >= 0 && y < 64)
+	int32_t page;
+
+	// Clip to OLED matrix
+	if (x0 < 0)
 	{
-		switch (color)
-		{
-		case 0:
-		{
-			oled_buffer[x + (y / 8) * 128] &= ~(1 << (y & 7));
-		}
-		break;
-		case 1:
+		x0 = 0;
+	}
+	if (y0 < 0)
+	{
+		y0 = 0;
+	}
+	if (x1 > OLED_WIDTH - 1)
+	{
+		x1 = OLED_WIDTH - 1;
+	}
+	if (y1 > OLED_HEIGHT - 1)
+	{
+		y1 = OLED_HEIGHT - 1;
+	}
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+
+	for (page = y0 / 8; page <= y1 / 8; page++)
+	{
+		if (x0 < display->dirty_first_col[page])
 		{
-			oled_buffer[x + (y / 8) * 128] |= (1 << (y & 7));
+			display->dirty_first_col[page] = x0;
 		}
-		break;
-		case 2:
+		if (x1 > display->dirty_last_col[page])
 		{
-			oled_buffer[x + (y / 8) * 128] ^= (1 << (y & 7));
-		}
-		break;
-		default:
-			break;
+			display->dirty_last_col[page] = x1;
 		}
 	}
 }
 
 /**
-  * @brief  Draw a line
-  * @param  x1: x coordinate of start point
-  * @param  y1: y coordinate of start point
-  * @param  x2: x coordinate of end point
-  * @param  y2: y coordinate of end point
+  * @brief  Mark the whole OLED buffer as changed.
   * @retval None.
   */
-void sd1306_draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color)
+static void sd1306_mark_all_dirty(void)
 {
-	int32_t x;
-	int32_t y;
-	int32_t addx;
-	int32_t addy;
-	int32_t dx;
-	int32_t dy;
-	int32_t P;
-	int32_t i;
+	memset(display->dirty_first_col, 0, sizeof(display->dirty_first_col));
+	memset(display->dirty_last_col, OLED_WIDTH - 1, sizeof(display->dirty_last_col));
+}
+
+/**
+  * @brief  Check a pixel against the clip rectangle.
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @retval Nonzero if the pixel is inside.
+  */
+static inline uint8_t sd1306_clip_contains(int32_t x, int32_t y)
+{
+	return x >= display->clip_x0 && x <= display->clip_x1 && y >= display->clip_y0 && y <= display->clip_y1;
+}
+
+/**
+  * @brief  Check a rectangle against the clip rectangle.
+  * @param  x0: left column
+  * @param  y0: top row
+  * @param  x1: right column
+  * @param  y1: bottom row
+  * @retval Nonzero if the whole rectangle is inside, so its pixels need no further checks.
+  */
+static inline uint8_t sd1306_clip_holds(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	return x0 >= display->clip_x0 && x1 <= display->clip_x1 && y0 >= display->clip_y0 && y1 <= display->clip_y1;
+}
+
+enum arc_octant_state
+{
+	octant_outside,
+	octant_inside,
+	octant_partial,
+};
+
+// Angles of an arc, counterclockwise in degrees from the positive x axis, and what each octant
+// of 45 degrees holds of it
+struct sd1306_arc
+{
+	int32_t a0;
+	int32_t a1;
+	// Arc crosses 0 degrees and covers a0 to 360 and 0 to a1
+	uint8_t wrap;
+	// Directions of a0 and a1 scaled by 16384
+	int32_t a0_x;
+	int32_t a0_y;
+	int32_t a1_x;
+	int32_t a1_y;
+	uint8_t octant[8];
+};
+
+/**
+  * @brief  Check if a point of a given octant is inside the arc angles
+  * @param  arc: arc to check against
+  * @param  dx: x offset from the center
+  * @param  dy: y offset from the center, up is positive
+  * @param  octant: octant of the point, 0 is 0 to 45 degrees
+  * @retval 1 if inside, 0 if not.
+  */
+static uint8_t sd1306_arc_contains(const struct sd1306_arc* arc, int32_t dx, int32_t dy, int32_t octant)
+{
+	int32_t lo;
+	int32_t hi;
+	uint8_t after_a0;
+	uint8_t before_a1;
 
-	dx = abs((int32_t)(x2 - x1));
-	dy = abs((int32_t)(y2 - y1));
-	x = x1;
-	y = y1;
+	if (arc->octant[octant] != octant_partial)
+	{
+		return arc->octant[octant] == octant_inside;
+	}
 
-	if (x1 > x2)
+	// A boundary inside the octant is less than 45 degrees from the point, so the sign of the
+	// cross product tells which side of it the point is on
+	lo = octant * 45;
+	hi = lo + 45;
+	if (arc->a0 <= lo)
+	{
+		after_a0 = 1;
+	}
+	else if (arc->a0 > hi)
 	{
-		addx = -1;
+		after_a0 = 0;
 	}
 	else
 	{
-		addx = 1;
+		after_a0 = arc->a0_x * dy - arc->a0_y * dx >= 0;
 	}
-	if (y1 > y2)
+	if (arc->a1 >= hi)
+	{
+		before_a1 = 1;
+	}
+	else if (arc->a1 < lo)
 	{
-		addy = -1;
+		before_a1 = 0;
 	}
 	else
 	{
-		addy = 1;
+		before_a1 = arc->a1_x * dy - arc->a1_y * dx <= 0;
 	}
 
-	if (dx >= dy)
-	{
-		P = 2 * dy - dx;
+	return arc->wrap ? (after_a0 || before_a1) : (after_a0 && before_a1);
+}
 
-		for (i = 0; i <= dx; ++i)
-		{
-			sd1306_draw_pixel(x, y, color);
+// Set, clear and xor variants of the primitives
+#define SD1306_ROP_NAME set
+#define SD1306_ROP(dst, bits) ((dst) |= (bits))
+#include "sd1306_rop.h"
+
+#define SD1306_ROP_NAME clear
+#define SD1306_ROP(dst, bits) ((dst) &= ~(bits))
+#include "sd1306_rop.h"
+
+#define SD1306_ROP_NAME xor
+#define SD1306_ROP(dst, bits) ((dst) ^= (bits))
+#include "sd1306_rop.h"
+
+// Call the variant of a sd1306_rop.h function that draws pixels of color
+#define SD1306_ROP_CALL(color, name, ...) \
+	do \
+	{ \
+		switch (color) \
+		{ \
+		case black_pixel: \
+			SD1306_ROP_EXPAND(name, clear)(__VA_ARGS__); \
+			break; \
+		case white_pixel: \
+			SD1306_ROP_EXPAND(name, set)(__VA_ARGS__); \
+			break; \
+		case inverse_pixel: \
+			SD1306_ROP_EXPAND(name, xor)(__VA_ARGS__); \
+			break; \
+		default: \
+			break; \
+		} \
+	} while (0)
 
-			if (P < 0)
-			{
-				P += 2 * dy;
-				x += addx;
-			}
-			else
-			{
-				P += 2 * dy - 2 * dx;
-				x += addx;
-				y += addy;
-			}
-		}
+/**
+  * @brief  Fill a rectangle with whole byte writes, one masked byte per column and page.
+  * @param  x0: left column
+  * @param  y0: top row
+  * @param  x1: right column
+  * @param  y1: bottom row
+  * @param  color: pixel color
+  * @retval None.
+  */
+static void sd1306_fill_area(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color)
+{
+	int32_t page;
+	int32_t last_page;
+	uint8_t mask;
+	uint8_t* row;
+
+	// Clip to the clip rectangle
+	if (x0 < display->clip_x0)
+	{
+		x0 = display->clip_x0;
 	}
-	else
+	if (y0 < display->clip_y0)
+	{
+		y0 = display->clip_y0;
+	}
+	if (x1 > display->clip_x1)
+	{
+		x1 = display->clip_x1;
+	}
+	if (y1 > display->clip_y1)
 	{
-		P = 2 * dx - dy;
+		y1 = display->clip_y1;
+	}
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
 
-		for (i = 0; i <= dy; ++i)
+	sd1306_mark_dirty(x0, y0, x1, y1);
+
+	last_page = y1 / 8;
+	for (page = y0 / 8; page <= last_page; page++)
+	{
+		// Rows of this page inside the rectangle, only the first and last page are partial
+		mask = 0xff;
+		if (page == y0 / 8)
+		{
+			mask &= 0xff << (y0 & 7);
+		}
+		if (page == last_page)
 		{
-			sd1306_draw_pixel(x, y, color);
+			mask &= 0xff >> (7 - (y1 & 7));
+		}
 
-			if (P < 0)
+		row = &oled_buffer[page * OLED_WIDTH];
+		if (mask == 0xff)
+		{
+			if (color == inverse_pixel)
 			{
-				P += 2 * dx;
-				y += addy;
+				sd1306_kernel_invert(&row[x0], x1 - x0 + 1);
 			}
 			else
 			{
-				P += 2 * dx - 2 * dy;
-				x += addx;
-				y += addy;
+				sd1306_kernel_fill(&row[x0], color == white_pixel ? 0xff : 0x00, x1 - x0 + 1);
 			}
+			continue;
 		}
+		SD1306_ROP_CALL(color, sd1306_span, row, x0, x1, mask);
 	}
 }
 
 /**
-  * @brief  Draw a vertical line
-  * @param  x: x coordinate of start point
-  * @param  y: y coordinate of start point
-  * @param  length: length of the line
+  * @brief  Draw one column of pixels, clipped, the caller marks it dirty
+  * @param  x: column
+  * @param  y0: top row
+  * @param  y1: bottom row
+  * @param  color: pixel color
   * @retval None.
   */
-void sd1306_draw_fast_Vline(uint8_t x, uint8_t y, uint8_t length, uint8_t color)
+static void sd1306_fill_column(int32_t x, int32_t y0, int32_t y1, uint8_t color)
 {
-	while (length > 0)
+	// Rows outside the clip rectangle are masked off by sd1306_column
+	if (y0 < 0)
+	{
+		y0 = 0;
+	}
+	if (y1 > OLED_HEIGHT - 1)
+	{
+		y1 = OLED_HEIGHT - 1;
+	}
+	if (y0 > y1)
 	{
-		sd1306_draw_pixel(x, y, color);
-		y++;
-		length--;
+		return;
 	}
+
+	SD1306_ROP_CALL(color, sd1306_column, x, y0, UINT64_MAX >> (OLED_HEIGHT - 1 - (y1 - y0)));
 }
 
 /**
-  * @brief  Draw a horizontal line
-  * @param  x: x coordinate of start point
-  * @param  y: y coordinate of start point
-  * @param  length: length of the line
+  * @brief  Draw one row of pixels, clipped, the caller marks it dirty
+  * @param  x0: left column
+  * @param  x1: right column
+  * @param  y: row
+  * @param  color: pixel color
   * @retval None.
   */
-void sd1306_draw_fast_Hline(uint8_t x, uint8_t y, uint8_t length, uint8_t color)
+static void sd1306_fill_row(int32_t x0, int32_t x1, int32_t y, uint8_t color)
 {
-	while (length > 0)
+	if (y < display->clip_y0 || y > display->clip_y1)
 	{
-		sd1306_draw_pixel(x, y, color);
-		x++;
-		length--;
+		return;
+	}
+	if (x0 < display->clip_x0)
+	{
+		x0 = display->clip_x0;
+	}
+	if (x1 > display->clip_x1)
+	{
+		x1 = display->clip_x1;
+	}
+	if (x0 > x1)
+	{
+		return;
 	}
+
+	SD1306_ROP_CALL(color, sd1306_span, &oled_buffer[(y / 8) * OLED_WIDTH], x0, x1, 1 << (y & 7));
 }
 
 /**
-  * @brief  Draw a rectangle given start point, width and height
-  * @param  x: x coordinate
-  * @param  y: y coordinate
-  * @param  width: rectangle width
-  * @param  height: rectangle height
-  * @retval None.
+  * @brief  Initialize the selected sd1306.
+  * @param  None.
+  * @retval Positive if was unsuccefully, zero if was succefully.
   */
-void sd1306_draw_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color)
+uint8_t sd1306_init(void)
 {
-	for (uint32_t i = x; i < x + width; i++)
+	uint8_t upside_down = display->orientation == orientation_upside_down;
+	const uint8_t init_commands[] =
 	{
-		// Draw the top line of rectangle
-		sd1306_draw_pixel(i, y, color);
-		// Draw the inferior line of rectangle
-		sd1306_draw_pixel(i, y + height, color);
-	}
-	for (uint32_t i = y; i < y + height; i++)
+		// OLED turn off
+		0xae,
+		// Set display oscillator freqeuncy and divide ratio
+		0xd5, 0x50,
+		// Set multiplex ratio
+		0xa8, 0x3f,
+		// Set display start line
+		0xd3, 0x00,
+		// Set the lower comulmn address
+		0x00,
+		// Set the higher comulmn address
+		0x10,
+		// Set page address
+		0xb0,
+		// Charge pump
+		0x8d, 0x14,
+		// Memory mode
+		0x20, 0x00,
+		// Set segment from left to right, or right to left upside down
+		upside_down ? 0xa0 : 0xa0 | 0x01,
+		// Set OLED upside up or upside down
+		upside_down ? 0xc0 : 0xc8,
+		// Set common signal pad configuration
+		0xda, 0x12,
+		// Set Contrast, contrast data
+		0x81, 0x00,
+		// Set discharge precharge periods
+		0xd9, 0xf1,
+		// Set common mode pad output voltage
+		0xdb, 0x40,
+		// Set Enire display
+		0xa4,
+		// Set Normal display
+		0xa6,
+		// Stop scroll
+		0x2e,
+		// OLED turn on
+		0xaf,
+		// Set column address, start column, last column
+		0x21, 0x00, 127,
+		// Set page address, start page, last page
+		0x22, 0x00, 0x07,
+	};
+
+	// Send the whole sequence in one transaction, fails if OLED is not connected
+	if (sd1306_send_command_list(display->addr, init_commands, sizeof(init_commands)) < 0)
 	{
-		// Draw the right line of rectangle
-		sd1306_draw_pixel(x, i, color);
-		// Draw lthe ledf line of rectangle
-		sd1306_draw_pixel(x + width, i, color);
+		return 1;
 	}
+
+	return 0;
 }
 
 /**
-  * @brief  Draw a fill rectangle given start point, width and height
+  * @brief  Draw a pixel at specified coordinates
   * @param  x: x coordinate
   * @param  y: y coordinate
-  * @param  width: rectangle width
-  * @param  height: rectangle height
   * @retval None.
   */
-void sd1306_draw_fill_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color)
+void sd1306_draw_pixel(int32_t x, int32_t y, uint8_t color)
 {
-	for (uint32_t i = x; i < x + width; i++)
+	// Verify that pixel is inside of the clip rectangle
+	if (sd1306_clip_contains(x, y))
 	{
-		for (uint32_t j = y; j < y + height; j++)
+		if (x < display->dirty_first_col[y / 8])
+		{
+			display->dirty_first_col[y / 8] = x;
+		}
+		if (x > display->dirty_last_col[y / 8])
 		{
-			sd1306_draw_pixel(i, j, color);
+			display->dirty_last_col[y / 8] = x;
 		}
+
+		SD1306_ROP_CALL(color, sd1306_plot, x, y, 0);
 	}
 }
 
 /**
-  * @brief  Draw a rounded rectangle given start point, width and height
+  * @brief  Set the clip rectangle, primitives only draw inside it and the OLED matrix
   * @param  x: x coordinate
   * @param  y: y coordinate
   * @param  width: rectangle width
   * @param  height: rectangle height
-  * @param  radius: radius of rounded corner
   * @retval None.
   */
-void sd1306_draw_round_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t radius, uint8_t color)
+void sd1306_set_clip(int32_t x, int32_t y, int32_t width, int32_t height)
 {
-	// Top
-	sd1306_draw_line(x + radius, y, x + width - radius, y, color);
-	// Bottom
-	sd1306_draw_line(x + radius, y + height - 1, x + width - radius, y + height - 1, color);
-	// Left
-	sd1306_draw_line(x, y + radius, x, y + height - radius, color);
-	// Right
-	sd1306_draw_line(x + width - 1, y + radius, x + width - 1, y + height - radius, color);
-
-	// draw four corners
+	int32_t page;
+	uint8_t mask;
 
-	sd1306_draw_circle_helper(x + radius, y + radius, radius, 1, color);
+	display->clip_x0 = x < 0 ? 0 : x;
+	display->clip_y0 = y < 0 ? 0 : y;
+	display->clip_x1 = x + width > OLED_WIDTH ? OLED_WIDTH - 1 : x + width - 1;
+	display->clip_y1 = y + height > OLED_HEIGHT ? OLED_HEIGHT - 1 : y + height - 1;
 
-	sd1306_draw_circle_helper(x + width - radius - 1, y + radius, radius, 2, color);
-	sd1306_draw_circle_helper(x + width - radius - 1, y + height - radius - 1, radius, 4, color);
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		mask = 0;
+		if (display->clip_x0 <= display->clip_x1 && display->clip_y0 <= page * 8 + 7 && display->clip_y1 >= page * 8)
+		{
+			mask = 0xff;
+			if (display->clip_y0 > page * 8)
+			{
+				mask &= 0xff << (display->clip_y0 & 7);
+			}
+			if (display->clip_y1 < page * 8 + 7)
+			{
+				mask &= 0xff >> (7 - (display->clip_y1 & 7));
+			}
+		}
+		display->clip_page_mask[page] = mask;
+	}
+}
+
+/**
+  * @brief  Reset the clip rectangle to the whole OLED matrix
+  * @retval None.
+  */
+void sd1306_reset_clip(void)
+{
+	sd1306_set_clip(0, 0, OLED_WIDTH, OLED_HEIGHT);
+}
+
+/**
+  * @brief  Draw a line
+  * @param  x1: x coordinate of start point
+  * @param  y1: y coordinate of start point
+  * @param  x2: x coordinate of end point
+  * @param  y2: y coordinate of end point
+  * @retval None.
+  */
+void sd1306_draw_line(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t color)
+{
+	int32_t left = x1 < x2 ? x1 : x2;
+	int32_t right = x1 < x2 ? x2 : x1;
+	int32_t top = y1 < y2 ? y1 : y2;
+	int32_t bottom = y1 < y2 ? y2 : y1;
+
+	sd1306_mark_dirty(left, top, right, bottom);
+
+	// Only lines crossing the clip rectangle edges check their pixels
+	if (sd1306_clip_holds(left, top, right, bottom))
+	{
+		SD1306_ROP_CALL(color, sd1306_line, x1, y1, x2, y2, 0);
+	}
+	else
+	{
+		SD1306_ROP_CALL(color, sd1306_line, x1, y1, x2, y2, 1);
+	}
+}
+
+/**
+  * @brief  Draw a vertical line
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  length: length of the line
+  * @retval None.
+  */
+void sd1306_draw_fast_Vline(uint8_t x, uint8_t y, uint8_t length, uint8_t color)
+{
+	sd1306_fill_area(x, y, x, y + length - 1, color);
+}
+
+/**
+  * @brief  Draw a horizontal line
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  length: length of the line
+  * @retval None.
+  */
+void sd1306_draw_fast_Hline(uint8_t x, uint8_t y, uint8_t length, uint8_t color)
+{
+	sd1306_fill_area(x, y, x + length - 1, y, color);
+}
+
+/**
+  * @brief  Draw a rectangle given start point, width and height
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @retval None.
+  */
+void sd1306_draw_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color)
+{
+	// Draw the top line of rectangle
+	sd1306_fill_area(x, y, x + width - 1, y, color);
+	// Draw the inferior line of rectangle
+	sd1306_fill_area(x, y + height, x + width - 1, y + height, color);
+	// Draw the right line of rectangle
+	sd1306_fill_area(x, y, x, y + height - 1, color);
+	// Draw lthe ledf line of rectangle
+	sd1306_fill_area(x + width, y, x + width, y + height - 1, color);
+}
+
+/**
+  * @brief  Draw a fill rectangle given start point, width and height
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @retval None.
+  */
+void sd1306_draw_fill_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color)
+{
+	sd1306_fill_area(x, y, x + width - 1, y + height - 1, color);
+}
+
+/**
+  * @brief  Clear a rectangle of OLED buffer given start point, width and height
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @retval None.
+  */
+void sd1306_clear_rect(int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	sd1306_fill_area(x, y, x + width - 1, y + height - 1, black_pixel);
+}
+
+/**
+  * @brief  Draw a rounded rectangle given start point, width and height
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @param  radius: radius of rounded corner
+  * @retval None.
+  */
+void sd1306_draw_round_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t radius, uint8_t color)
+{
+	// Top
+	sd1306_fill_area(x + radius, y, x + width - radius, y, color);
+	// Bottom
+	sd1306_fill_area(x + radius, y + height - 1, x + width - radius, y + height - 1, color);
+	// Left
+	sd1306_fill_area(x, y + radius, x, y + height - radius, color);
+	// Right
+	sd1306_fill_area(x + width - 1, y + radius, x + width - 1, y + height - radius, color);
+
+	// draw four corners
+
+	sd1306_draw_circle_helper(x + radius, y + radius, radius, 1, color);
+
+	sd1306_draw_circle_helper(x + width - radius - 1, y + radius, radius, 2, color);
+	sd1306_draw_circle_helper(x + width - radius - 1, y + height - radius - 1, radius, 4, color);
 	sd1306_draw_circle_helper(x + radius, y + height - radius - 1, radius, 8, color);
 
 }
@@ -415,36 +947,17 @@ void sd1306_draw_fillround_Rect(uint8_t x, uint8_t y, uint8_t width, uint8_t hei
   */
 void sd1306_draw_circle(int32_t x, int32_t y, int32_t radius, uint8_t color)
 {
-	int32_t a;
-	int32_t b;
-	int32_t P;
-	a = 0x00;
-	b = radius;
-	P = 0x01 - radius;
+	sd1306_mark_dirty(x - radius, y - radius, x + radius, y + radius);
 
-	do
+	// Only circles crossing the clip rectangle edges check their pixels
+	if (sd1306_clip_holds(x - radius, y - radius, x + radius, y + radius))
 	{
-		{
-			sd1306_draw_pixel(a + x, b + y, color);
-			sd1306_draw_pixel(b + x, a + y, color);
-			sd1306_draw_pixel(x - a, b + y, color);
-			sd1306_draw_pixel(x - b, a + y, color);
-			sd1306_draw_pixel(b + x, y - a, color);
-			sd1306_draw_pixel(a + x, y - b, color);
-			sd1306_draw_pixel(x - a, y - b, color);
-			sd1306_draw_pixel(x - b, y - a, color);
-		}
-
-		if (P < 0)
-		{
-			P += 3 + 2 * a++;
-		}
-		else
-		{
-			P += 5 + 2 * (a++ - b--);
-		}
-
-	} while (a <= b);
+		SD1306_ROP_CALL(color, sd1306_circle, x, y, radius, 0);
+	}
+	else
+	{
+		SD1306_ROP_CALL(color, sd1306_circle, x, y, radius, 1);
+	}
 }
 
 /**
@@ -463,12 +976,18 @@ void sd1306_draw_fill_circle(int32_t x, int32_t y, int32_t radius, uint8_t color
 	b = radius;
 	P = 0x01 - radius;
 
-	do
+	sd1306_mark_dirty(x - radius, y - radius, x + radius, y + radius);
+
+	// A column is whole bytes of OLED buffer, so the circle is filled a column at a time. Every
+	// column is drawn once, inverse_pixel would undo the pixels drawn twice.
+	while (a <= b)
 	{
-		sd1306_draw_line(x - a, y + b, x + a, y + b, color);
-		sd1306_draw_line(x - a, y - b, x + a, y - b, color);
-		sd1306_draw_line(x - b, y + a, x + b, y + a, color);
-		sd1306_draw_line(x - b, y - a, x + b, y - a, color);
+		// Columns a away from the center are b high
+		sd1306_fill_column(x - a, y - b, y + b, color);
+		if (a != 0)
+		{
+			sd1306_fill_column(x + a, y - b, y + b, color);
+		}
 
 		if (P < 0)
 		{
@@ -476,10 +995,15 @@ void sd1306_draw_fill_circle(int32_t x, int32_t y, int32_t radius, uint8_t color
 		}
 		else
 		{
+			// Columns b away are as high as the last a before b moves in, unless they are a columns
+			if (b > a)
+			{
+				sd1306_fill_column(x - b, y - a, y + a, color);
+				sd1306_fill_column(x + b, y - a, y + a, color);
+			}
 			P += 5 + 2 * (a++ - b--);
 		}
-
-	} while (a <= b);
+	}
 }
 
 /**
@@ -521,6 +1045,8 @@ void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, u
 	int16_t dy02;
 	int16_t dx12;
 	int16_t dy12;
+	int16_t left;
+	int16_t right;
 	int32_t sa, sb;
 
 	// Sort coordinates by Y order (y2 >= y1 >= y0)
@@ -559,10 +1085,17 @@ void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, u
 		{
 			b = x2;
 		}
-		sd1306_draw_fast_Hline(a, y0, b - a + 1, color);
+		sd1306_fill_area(a, y0, b, y0, color);
 		return;
 	}
 
+	// Each row is one span, drawn once, so inverse_pixel inverts the triangle exactly
+	left = x0 < x1 ? x0 : x1;
+	left = x2 < left ? x2 : left;
+	right = x0 > x1 ? x0 : x1;
+	right = x2 > right ? x2 : right;
+	sd1306_mark_dirty(left, y0, right, y2);
+
 	dx01 = x1 - x0;
 	dy01 = y1 - y0;
 	dx02 = x2 - x0;
@@ -598,7 +1131,7 @@ void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, u
 		{
 			_swap(a, b);
 		}
-		sd1306_draw_fast_Hline(a, y, b - a + 1, color);
+		sd1306_fill_row(a, b, y, color);
 	}
 
 	// For lower part of triangle, find scanline crossings for segments
@@ -616,7 +1149,7 @@ void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, u
 		{
 			_swap(a, b);
 		}
-		sd1306_draw_fast_Hline(a, y, b - a + 1, color);
+		sd1306_fill_row(a, b, y, color);
 	}
 }
 
@@ -629,6 +1162,31 @@ void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, u
   * @retval None.
   */
 void sd1306_draw_circle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t cornername, uint8_t color)
+{
+	sd1306_mark_dirty(x0 - radius, y0 - radius, x0 + radius, y0 + radius);
+
+	// Only corners crossing the clip rectangle edges check their pixels
+	if (sd1306_clip_holds(x0 - radius, y0 - radius, x0 + radius, y0 + radius))
+	{
+		SD1306_ROP_CALL(color, sd1306_circle_corners, x0, y0, radius, cornername, 0);
+	}
+	else
+	{
+		SD1306_ROP_CALL(color, sd1306_circle_corners, x0, y0, radius, cornername, 1);
+	}
+}
+
+/**
+  * @brief  Used to do fill round rectangles
+  * @param  x0: x center coordinate
+  * @param  y0: y center coordinate
+  * @param  radius: radius
+  * @param  cornername: corner to draw the semicircle
+  * @param  delta:
+  * @retval None.
+  * @note   The center column is left to the caller.
+  */
+void sd1306_draw_fillcircle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t cornername, uint8_t delta, uint8_t color)
 {
 	int16_t f = 1 - radius;
 	int16_t ddF_x = 1;
@@ -636,6 +1194,9 @@ void sd1306_draw_circle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t c
 	int16_t x = 0;
 	int16_t y = radius;
 
+	sd1306_mark_dirty(x0 - radius, y0 - radius, x0 + radius, y0 + radius + 1 + delta);
+
+	// Every column is drawn once, inverse_pixel would undo the pixels drawn twice
 	while (x < y)
 	{
 		if (f >= 0)
@@ -647,431 +1208,1458 @@ void sd1306_draw_circle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t c
 		x++;
 		ddF_x += 2;
 		f += ddF_x;
-		if (cornername & 0x4)
+
+		// Columns x away from the center are y high
+		if (cornername & 0x1)
 		{
-			sd1306_draw_pixel(x0 + x, y0 + y, color);
-			sd1306_draw_pixel(x0 + y, y0 + x, color);
+			sd1306_fill_column(x0 + x, y0 - y, y0 + y + 1 + delta, color);
 		}
 		if (cornername & 0x2)
 		{
-			sd1306_draw_pixel(x0 + x, y0 - y, color);
-			sd1306_draw_pixel(x0 + y, y0 - x, color);
+			sd1306_fill_column(x0 - x, y0 - y, y0 + y + 1 + delta, color);
 		}
-		if (cornername & 0x8)
+
+		// Columns y away are as high as the last x before y moves in, unless x reaches them next
+		if (f < 0 || y <= x + 1)
 		{
-			sd1306_draw_pixel(x0 - y, y0 + x, color);
-			sd1306_draw_pixel(x0 - x, y0 + y, color);
+			continue;
 		}
 		if (cornername & 0x1)
 		{
-			sd1306_draw_pixel(x0 - y, y0 - x, color);
-			sd1306_draw_pixel(x0 - x, y0 - y, color);
+			sd1306_fill_column(x0 + y, y0 - x, y0 + x + 1 + delta, color);
+		}
+		if (cornername & 0x2)
+		{
+			sd1306_fill_column(x0 - y, y0 - x, y0 + x + 1 + delta, color);
 		}
 	}
 }
 
+
 /**
-  * @brief  Used to do fill round rectangles
-  * @param  x0: x center coordinate
-  * @param  y0: y center coordinate
-  * @param  radius: radius
-  * @param  cornername: corner to draw the semicircle
-  * @param  delta:
+  * @brief  Stretch a font column vertically so every font row becomes size pixel rows.
+  * @param  bits: font column, bit 0 is the top row
+  * @param  size: scale
+  * @param  first_row: first pixel row of the stretched column to keep
+  * @retval Pixel rows first_row to first_row + 63 of the stretched column, first_row in bit 0.
+  */
+static uint64_t sd1306_scale_column(uint8_t bits, int32_t size, int32_t first_row)
+{
+	uint64_t column = 0;
+	int32_t row;
+	int32_t top;
+	int32_t bottom;
+
+	for (row = 0; bits != 0; row++, bits >>= 1)
+	{
+		if (!(bits & 1))
+		{
+			continue;
+		}
+		// Pixel rows of this font row that land in the kept range
+		top = row * size - first_row;
+		bottom = top + size;
+		if (top < 0)
+		{
+			top = 0;
+		}
+		if (bottom > 64)
+		{
+			bottom = 64;
+		}
+		if (top < bottom)
+		{
+			column |= (bottom - top == 64 ? ~0ULL : ((1ULL << (bottom - top)) - 1)) << top;
+		}
+	}
+	return column;
+}
+
+/**
+  * @brief  Draw a page native bitmap, page rows of column bytes with bit 0 the top row of the page
+  * @param  x: x coordinate of the bitmap
+  * @param  y: y coordinate of the bitmap
+  * @param  columns: pages rows of width bytes
+  * @param  width: bitmap width
+  * @param  height: bitmap height, at most 64
+  * @param  color: pixel color
   * @retval None.
   */
-void sd1306_draw_fillcircle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t cornername, uint8_t delta, uint8_t color)
+void sd1306_draw_columns(int32_t x, int32_t y, const uint8_t* columns, int32_t width, int32_t height, uint8_t color)
 {
-	int16_t f = 1 - radius;
-	int16_t ddF_x = 1;
-	int16_t ddF_y = -2 * radius;
-	int16_t x = 0;
-	int16_t y = radius;
+	sd1306_mark_dirty(x, y, x + width - 1, y + height - 1);
+	SD1306_ROP_CALL(color, sd1306_glyph, x, y, columns, width, height);
+}
 
-	while (x < y)
+/**
+  * @brief  Find the pre-scaled glyph of a character
+  * @param  character: character to find
+  * @param  size: scale
+  * @retval Glyph in font_atlas.h or font.h, NULL if the size has no atlas.
+  */
+static const uint8_t* sd1306_atlas_glyph(uint8_t character, int32_t size)
+{
+	// font.h is already page native at size 1
+	if (size == 1)
 	{
-		if (f >= 0)
+		return font_data[character - ' '];
+	}
+	if (character < FONT_ATLAS_FIRST || character > FONT_ATLAS_LAST)
+	{
+		return NULL;
+	}
+
+	switch (size)
+	{
+#ifdef FONT_ATLAS_2X
+	case 2:
+		return &font_atlas_2x[character - FONT_ATLAS_FIRST][0][0];
+#endif
+#ifdef FONT_ATLAS_3X
+	case 3:
+		return &font_atlas_3x[character - FONT_ATLAS_FIRST][0][0];
+#endif
+#ifdef FONT_ATLAS_4X
+	case 4:
+		return &font_atlas_4x[character - FONT_ATLAS_FIRST][0][0];
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/**
+  * @brief  Draw a string
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  textptr: pointer
+  * @param  size: scale
+  * @param  large_digits: draw digits, colon and space with the large digit face, size must be 4
+  * @retval None.
+  */
+static void sd1306_draw_text(int32_t x, int32_t y, uint8_t* textptr, int32_t size, uint8_t color, uint8_t large_digits)
+{
+	// Loop counters
+	uint8_t i;
+	uint8_t j;
+	uint8_t m;
+	// Pre-scaled character
+	const uint8_t* glyph;
+	const char* digit;
+	// Stretched character column
+	uint64_t column;
+	// Glyph rows above the OLED are cut off
+	int32_t first_row;
+
+	// Loop through the passed string
+	for (i = 0; textptr[i] != 0x00; ++i, ++x)
+	{
+		// Performs character wrapping
+		if (x + 5 * size >= 128)
 		{
-			y--;
-			ddF_y += 2;
-			f += ddF_y;
+			// Set x at far left position
+			x = 0;
+			// Set y at next position down
+			y += 7 * size + 1;
 		}
-		x++;
-		ddF_x += 2;
-		f += ddF_x;
 
-		if (cornername & 0x1)
+		digit = large_digits ? strchr(FONT_LARGE_DIGITS, textptr[i]) : NULL;
+		if (digit != NULL)
 		{
-			sd1306_draw_line(x0 + x, y0 - y, x0 + x, y0 - y + 2 * y + 1 + delta, color);
-			sd1306_draw_line(x0 + y, y0 - x, x0 + y, y0 - x + 2 * x + 1 + delta, color);
+			sd1306_draw_columns(x, y, &font_large_digits[digit - FONT_LARGE_DIGITS][0][0], 5 * size, 7 * size, color);
+			x += 5 * size;
+			continue;
 		}
-		if (cornername & 0x2)
+
+		glyph = sd1306_atlas_glyph(textptr[i], size);
+		if (glyph != NULL)
+		{
+			sd1306_draw_columns(x, y, glyph, 5 * size, 7 * size, color);
+			x += 5 * size;
+			continue;
+		}
+
+		// No atlas for this size, stretch the font columns here
+		const uint8_t* pixelData = font_data[textptr[i] - ' '];
+		first_row = y < 0 ? -y : 0;
+		sd1306_mark_dirty(x, y, x + 5 * size - 1, y + 7 * size - 1);
+
+		// Loop through character byte data
+		for (j = 0; j < 5; ++j, x += size)
 		{
-			sd1306_draw_line(x0 - x, y0 - y, x0 - x, y0 - y + 2 * y + 1 + delta, color);
-			sd1306_draw_line(x0 - y, y0 - x, x0 - y, y0 - x + 2 * x + 1 + delta, color);
+			column = sd1306_scale_column(pixelData[j], size, first_row);
+			if (column == 0)
+			{
+				continue;
+			}
+			// Repeat the column to change the character's width
+			for (m = 0; m < size; ++m)
+			{
+				SD1306_ROP_CALL(color, sd1306_column, x + m, y + first_row, column);
+			}
 		}
 	}
 }
 
-
 /**
-  * @brief  Check if the n bit of a byte is set.
-  * @param  data: byte to test
-  * @param  n: bit to test
-  * @retval 0 if is clear or 1 if is set.
+  * @brief  Draw a string
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  textptr: pointer
+  * @param  size: scale
+  * @retval None.
+  */
+void sd1306_draw_string(int32_t x, int32_t y, uint8_t* textptr, int32_t size, uint8_t color)
+{
+	sd1306_draw_text(x, y, textptr, size, color, 0);
+}
+
+/**
+  * @brief  Draw a string at size 4 with the large digit face for digits, colon and space
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  textptr: pointer
+  * @retval None.
+  */
+void sd1306_draw_large_digits(int32_t x, int32_t y, uint8_t* textptr, uint8_t color)
+{
+	sd1306_draw_text(x, y, textptr, 4, color, 1);
+}
+
+/**
+  * @brief  Render a string into a page native bitmap instead of OLED buffer, without wrapping
+  * @param  columns: bitmap, pages rows of width bytes, cleared first
+  * @param  width: bitmap width, characters past it are cut off
+  * @param  height: bitmap height, at most 64
+  * @param  textptr: pointer
+  * @param  size: scale
+  * @param  large_digits: draw digits, colon and space with the large digit face, size must be 4
+  * @retval Width of the rendered string.
+  */
+int32_t sd1306_render_string_columns(uint8_t* columns, int32_t width, int32_t height, const uint8_t* textptr, int32_t size, uint8_t large_digits)
+{
+	int32_t pages = (height + 7) / 8;
+	int32_t glyph_pages = (7 * size + 7) / 8;
+	int32_t glyph_width = 5 * size;
+	int32_t x = 0;
+	int32_t count;
+	int32_t page;
+	int32_t j;
+	int32_t m;
+	const uint8_t* glyph;
+	const char* digit;
+	uint64_t column;
+
+	memset(columns, 0, width * pages);
+	if (glyph_pages > pages)
+	{
+		glyph_pages = pages;
+	}
+
+	for (; *textptr != 0x00 && x < width; textptr++, x += glyph_width + 1)
+	{
+		count = x + glyph_width > width ? width - x : glyph_width;
+
+		digit = large_digits ? strchr(FONT_LARGE_DIGITS, *textptr) : NULL;
+		glyph = digit != NULL ? &font_large_digits[digit - FONT_LARGE_DIGITS][0][0] : sd1306_atlas_glyph(*textptr, size);
+		if (glyph != NULL)
+		{
+			// Pre-scaled glyph rows are bitmap rows already
+			for (page = 0; page < glyph_pages; page++)
+			{
+				memcpy(&columns[page * width + x], &glyph[page * glyph_width], count);
+			}
+			continue;
+		}
+
+		// No atlas for this size, stretch the font columns here
+		for (j = 0; j < 5; j++)
+		{
+			column = sd1306_scale_column(font_data[*textptr - ' '][j], size, 0);
+			for (m = 0; m < size && j * size + m < count; m++)
+			{
+				for (page = 0; page < pages; page++)
+				{
+					columns[page * width + x + j * size + m] = (uint8_t)(column >> (page * 8));
+				}
+			}
+		}
+	}
+	// Last character is followed by a blank column that is not part of the string
+	if (x > width)
+	{
+		return width;
+	}
+	return x > 0 ? x - 1 : 0;
+}
+
+/**
+  * @brief  Set the display upside down.
+  * @retval None.
+  */
+void upside_down(void)
+{
+	static const uint8_t upside_down_commands[] =
+	{
+		// Set OLED upside down
+		0xc0,
+		// Set segment from right to left
+		0xa0,
+	};
+
+	sd1306_send_command_list(display->addr, upside_down_commands, sizeof(upside_down_commands));
+	display->orientation = orientation_upside_down;
+	// Segment remap only applies to data written after it, so resend everything
+	sd1306_invalidate();
+}
+
+/**
+  * @brief  Set the display upside up.
+  * @retval None.
+  */
+void upside_up(void)
+{
+	static const uint8_t upside_up_commands[] =
+	{
+		// Set OLED upside up
+		0xc8,
+		// Set segment from left to right
+		0xa1,
+	};
+
+	sd1306_send_command_list(display->addr, upside_up_commands, sizeof(upside_up_commands));
+	display->orientation = orientation_upside_up;
+	// Segment remap only applies to data written after it, so resend everything
+	sd1306_invalidate();
+}
+
+/**
+  * @brief  Stop the running scroll, the RAM of the scrolled pages no longer matches any frame
+  * @param  panel: panel to stop
+  * @param  dirty_first: first changed column of each page, the scrolled pages become fully changed
+  * @param  dirty_last: last changed column of each page, the scrolled pages become fully changed
+  * @retval None.
+  */
+static void sd1306_halt_scroll(struct sd1306_display* panel, uint8_t* dirty_first, uint8_t* dirty_last)
+{
+	static const uint8_t halt_commands[] =
+	{
+		// Stop scroll
+		0x2e,
+		// Set display start line, diagonal scroll moves it
+		0x40,
+	};
+	uint8_t page;
+
+	sd1306_send_command_list(panel->addr, halt_commands, sizeof(halt_commands));
+
+	for (page = panel->scroll_running.first_page; page <= panel->scroll_running.last_page; page++)
+	{
+		panel->shadow_valid_pages &= ~(1 << page);
+		dirty_first[page] = 0;
+		dirty_last[page] = OLED_WIDTH - 1;
+	}
+	panel->scroll_running.length = 0;
+}
+
+/**
+  * @brief  Slide a frame in from the bottom with the display start line, a page per step
+  * @param  panel: panel to send to
+  * @param  pixels: frame to send
+  * @param  dirty_first: first changed column of each page, cleared for the pages sent
+  * @param  dirty_last: last changed column of each page, cleared for the pages sent
+  * @param  step_ms: time between steps
+  * @param  bytes_sent: incremented by the data bytes written
+  * @retval Nonzero if any page was written.
+  * @note   Raising the start line a page moves the top page to the bottom of the display, where it
+  *         is overwritten with the next page of the frame. After 8 pages the start line is back at
+  *         zero and RAM holds the frame, so OLED RAM layout is the same as after a plain flush.
+  */
+static uint8_t sd1306_slide_in(struct sd1306_display* panel, uint8_t* pixels, uint8_t* dirty_first, uint8_t* dirty_last,
+	uint32_t step_ms, uint32_t* bytes_sent)
+{
+	struct timespec step = { step_ms / 1000, (step_ms % 1000) * 1000000 };
+	uint8_t start_line;
+	uint8_t page;
+	uint8_t sent = 0;
+
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		start_line = 0x40 | (((page + 1) * 8) & 0x3f);
+		sd1306_send_command_list(panel->addr, &start_line, 1);
+
+		if (sd1306_write_window(panel, pixels, page, page, 0, OLED_WIDTH - 1) >= 0)
+		{
+			sd1306_kernel_copy(&panel->shadow_buffer[page * OLED_WIDTH], &pixels[page * OLED_WIDTH], OLED_WIDTH);
+			panel->shadow_valid_pages |= 1 << page;
+			dirty_first[page] = OLED_WIDTH;
+			dirty_last[page] = 0;
+			*bytes_sent += OLED_WIDTH;
+			sent = 1;
+		}
+		else
+		{
+			// Resent by the next refresh
+			panel->shadow_valid_pages &= ~(1 << page);
+			dirty_first[page] = 0;
+			dirty_last[page] = OLED_WIDTH - 1;
+		}
+
+		if (page + 1 < OLED_PAGES)
+		{
+			nanosleep(&step, NULL);
+		}
+	}
+	return sent;
+}
+
+/**
+  * @brief  Add the effects of a newer frame to the effects of an older one
+  * @param  dst: effects of the older frame
+  * @param  src: effects of the newer frame, cleared
+  * @retval None.
+  */
+static void sd1306_merge_effects(struct sd1306_effects* dst, struct sd1306_effects* src)
+{
+	if (src->scroll_changed)
+	{
+		dst->scroll = src->scroll;
+		dst->scroll_changed = 1;
+	}
+	if (src->slide_step_ms != 0)
+	{
+		dst->slide_step_ms = src->slide_step_ms;
+	}
+	memset(src, 0, sizeof(*src));
+}
+
+/**
+  * @brief  Start sending the changed windows of a frame to OLED RAM
+  * @param  job: job to set up, sent with sd1306_flush_next and finished with sd1306_flush_end
+  * @param  panel: panel to send to
+  * @param  pixels: frame to send
+  * @param  dirty_first: first changed column of each page, updated to what is left to send
+  * @param  dirty_last: last changed column of each page, updated to what is left to send
+  * @param  presented: when the oldest change in the frame was made ready to send
+  * @param  effects: scroll and slide to apply with the frame
+  * @retval None.
+  * @note   Stops the scroll when RAM is to be written. A slide is sent whole from here.
+  */
+static void sd1306_flush_begin(struct sd1306_flush_job* job, struct sd1306_display* panel, uint8_t* pixels,
+	uint8_t* dirty_first, uint8_t* dirty_last, const struct timespec* presented, const struct sd1306_effects* effects)
+{
+	uint8_t page;
+	uint8_t changed = 0;
+
+	job->panel = panel;
+	job->pixels = pixels;
+	job->dirty_first = dirty_first;
+	job->dirty_last = dirty_last;
+	job->presented = *presented;
+	job->page = 0;
+	job->sent = 0;
+	job->start_scroll = effects->scroll_changed;
+	job->bytes_sent = 0;
+	job->resume = effects->scroll_changed ? effects->scroll : panel->scroll_running;
+
+	pthread_mutex_lock(&flush_lock);
+	if (panel->shadow_reset)
+	{
+		panel->shadow_valid_pages = 0;
+		panel->shadow_reset = 0;
+	}
+	pthread_mutex_unlock(&flush_lock);
+
+	// Shrink each dirty window to the bytes that really differ from OLED RAM
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		if (dirty_first[page] > dirty_last[page] || !(panel->shadow_valid_pages & (1 << page)))
+		{
+			continue;
+		}
+		int32_t first = sd1306_first_change(panel, pixels, page, dirty_first[page], dirty_last[page]);
+		if (first > dirty_last[page])
+		{
+			// Redrawn with the same pixels
+			dirty_first[page] = OLED_WIDTH;
+			dirty_last[page] = 0;
+			continue;
+		}
+		dirty_first[page] = first;
+		dirty_last[page] = sd1306_last_change(panel, pixels, page, first, dirty_last[page]);
+	}
+
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		changed |= dirty_first[page] <= dirty_last[page];
+	}
+
+	// RAM must not be written while scrolling, a scroll with nothing to write keeps running
+	if (panel->scroll_running.length != 0 && (changed || effects->scroll_changed || effects->slide_step_ms != 0))
+	{
+		sd1306_halt_scroll(panel, dirty_first, dirty_last);
+		job->start_scroll = 1;
+	}
+
+	if (effects->slide_step_ms != 0)
+	{
+		job->sent = sd1306_slide_in(panel, pixels, dirty_first, dirty_last, effects->slide_step_ms, &job->bytes_sent);
+		job->page = OLED_PAGES;
+	}
+}
+
+/**
+  * @brief  Send the next changed window of a frame
+  * @param  job: job set up by sd1306_flush_begin
+  * @retval Nonzero if a window was sent or tried, zero when the frame is done.
+  * @note   Full width pages are contiguous in the buffer, so a run of them goes as one window.
+  */
+static uint8_t sd1306_flush_next(struct sd1306_flush_job* job)
+{
+	struct sd1306_display* panel = job->panel;
+	uint8_t* dirty_first = job->dirty_first;
+	uint8_t* dirty_last = job->dirty_last;
+	uint8_t page = job->page;
+	uint8_t last_page;
+	uint8_t first_col;
+	uint8_t last_col;
+
+	// Skip the pages where nothing changed
+	while (page < OLED_PAGES && dirty_first[page] > dirty_last[page])
+	{
+		page++;
+	}
+	if (page >= OLED_PAGES)
+	{
+		job->page = OLED_PAGES;
+		return 0;
+	}
+
+	last_page = page;
+	first_col = dirty_first[page];
+	last_col = dirty_last[page];
+	if (first_col == 0 && last_col == OLED_WIDTH - 1)
+	{
+		while (last_page + 1 < OLED_PAGES && dirty_first[last_page + 1] == 0 &&
+			dirty_last[last_page + 1] == OLED_WIDTH - 1)
+		{
+			last_page++;
+		}
+	}
+	job->page = last_page + 1;
+
+	// Keep the window dirty if it did not make it to the OLED so next refresh retries it
+	if (sd1306_write_window(panel, job->pixels, page, last_page, first_col, last_col) < 0)
+	{
+		return 1;
+	}
+	job->sent = 1;
+	job->bytes_sent += (last_page - page + 1) * (last_col - first_col + 1);
+
+	sd1306_kernel_copy_rect(panel->shadow_buffer, job->pixels, page, last_page, first_col, last_col);
+	for (uint8_t i = page; i <= last_page; i++)
+	{
+		if (first_col == 0 && last_col == OLED_WIDTH - 1)
+		{
+			panel->shadow_valid_pages |= 1 << i;
+		}
+		dirty_first[i] = OLED_WIDTH;
+		dirty_last[i] = 0;
+	}
+	return 1;
+}
+
+/**
+  * @brief  Finish sending a frame, start the scroll and count the frame
+  * @param  job: job whose windows were all sent by sd1306_flush_next
+  * @retval None.
+  */
+static void sd1306_flush_end(struct sd1306_flush_job* job)
+{
+	struct sd1306_display* panel = job->panel;
+	struct sd1306_stats* stats = &panel->refresh_stats;
+	uint32_t latency_us;
+	struct timespec now;
+
+	if (job->start_scroll && job->resume.length != 0 &&
+		sd1306_send_command_list(panel->addr, job->resume.commands, job->resume.length) >= 0)
+	{
+		panel->scroll_running = job->resume;
+	}
+
+	if (job->sent && backend != NULL && backend->frame_done != NULL)
+	{
+		backend->frame_done(backend->context);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	latency_us = (uint32_t)((now.tv_sec - job->presented.tv_sec) * 1000000 + (now.tv_nsec - job->presented.tv_nsec) / 1000);
+
+	pthread_mutex_lock(&flush_lock);
+	if (job->sent)
+	{
+		if (stats->frames_sent == 0 || latency_us < stats->latency_min_us)
+		{
+			stats->latency_min_us = latency_us;
+		}
+		if (latency_us > stats->latency_max_us)
+		{
+			stats->latency_max_us = latency_us;
+		}
+		panel->latency_total_us += latency_us;
+		stats->frames_sent++;
+		stats->bytes_sent += job->bytes_sent;
+	}
+	else
+	{
+		stats->frames_skipped++;
+	}
+	pthread_mutex_unlock(&flush_lock);
+}
+
+/**
+  * @brief  Send the changed windows of a frame to OLED RAM
+  * @param  panel: panel to send to
+  * @param  pixels: frame to send
+  * @param  dirty_first: first changed column of each page, updated to what is left to send
+  * @param  dirty_last: last changed column of each page, updated to what is left to send
+  * @param  presented: when the oldest change in the frame was made ready to send
+  * @param  effects: scroll and slide to apply with the frame
+  * @retval None.
+  */
+static void sd1306_flush(struct sd1306_display* panel, uint8_t* pixels, uint8_t* dirty_first, uint8_t* dirty_last,
+	const struct timespec* presented, const struct sd1306_effects* effects)
+{
+	struct sd1306_flush_job job;
+
+	sd1306_flush_begin(&job, panel, pixels, dirty_first, dirty_last, presented, effects);
+	while (sd1306_flush_next(&job))
+	{
+	}
+	sd1306_flush_end(&job);
+}
+
+/**
+  * @brief  Make the frame buffers of a panel empty for the flush thread, flush_lock must be held
+  * @param  panel: panel to set up
+  * @retval None.
+  */
+static void sd1306_reset_flush_frames(struct sd1306_display* panel)
+{
+	uint8_t page;
+
+	panel->ready_frame.pixels = &panel->flush_frames[0][OLED_FRAME_PREFIX];
+	panel->front_frame.pixels = &panel->flush_frames[1][OLED_FRAME_PREFIX];
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		panel->ready_frame.first_col[page] = OLED_WIDTH;
+		panel->ready_frame.last_col[page] = 0;
+		panel->front_frame.first_col[page] = OLED_WIDTH;
+		panel->front_frame.last_col[page] = 0;
+	}
+	memset(&panel->ready_frame.effects, 0, sizeof(panel->ready_frame.effects));
+	panel->ready_pending = 0;
+}
+
+/**
+  * @brief  Take the ready frame of a panel as its front frame, flush_lock must be held
+  * @param  panel: panel with a frame ready
+  * @retval None.
+  */
+static void sd1306_take_ready_frame(struct sd1306_display* panel)
+{
+	struct sd1306_frame* ready = &panel->ready_frame;
+	struct sd1306_frame* front = &panel->front_frame;
+	uint8_t* pixels;
+	uint8_t page;
+
+	// Windows the front frame failed to send carry over
+	pixels = front->pixels;
+	front->pixels = ready->pixels;
+	ready->pixels = pixels;
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		if (ready->first_col[page] < front->first_col[page])
+		{
+			front->first_col[page] = ready->first_col[page];
+		}
+		if (ready->last_col[page] > front->last_col[page])
+		{
+			front->last_col[page] = ready->last_col[page];
+		}
+		ready->first_col[page] = OLED_WIDTH;
+		ready->last_col[page] = 0;
+	}
+	front->presented = ready->presented;
+	memset(&front->effects, 0, sizeof(front->effects));
+	sd1306_merge_effects(&front->effects, &ready->effects);
+	panel->ready_pending = 0;
+}
+
+/**
+  * @brief  Check if any open panel has a frame handed over, flush_lock must be held
+  * @retval Nonzero if a frame is ready.
+  */
+static uint8_t sd1306_frames_ready(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < SD1306_MAX_DISPLAYS; i++)
+	{
+		if (displays[i].open && displays[i].ready_pending)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+  * @brief  Send frames handed over by sd1306_refresh until sd1306_stop_flush_thread
+  * @param  arg: unused
+  * @retval NULL.
+  * @note   The frames ready on the panels are sent together a window of each panel in turn, so a
+  *         small change on one panel does not wait for a whole frame of another to go out.
+  */
+static void* sd1306_flush_loop(void* arg)
+{
+	struct sd1306_flush_job jobs[SD1306_MAX_DISPLAYS];
+	struct sd1306_display* panels[SD1306_MAX_DISPLAYS];
+	uint8_t count;
+	uint8_t busy;
+	uint8_t i;
+
+	(void)arg;
+
+	pthread_mutex_lock(&flush_lock);
+	for (;;)
+	{
+		while (!sd1306_frames_ready() && !flush_stop)
+		{
+			pthread_cond_wait(&flush_cond, &flush_lock);
+		}
+		// The last frames handed over are sent before stopping
+		if (!sd1306_frames_ready())
+		{
+			break;
+		}
+
+		count = 0;
+		for (i = 0; i < SD1306_MAX_DISPLAYS; i++)
+		{
+			if (displays[i].open && displays[i].ready_pending)
+			{
+				sd1306_take_ready_frame(&displays[i]);
+				panels[count++] = &displays[i];
+			}
+		}
+
+		// Drawing and the next refresh go on while the frames are on the bus
+		pthread_mutex_unlock(&flush_lock);
+		for (i = 0; i < count; i++)
+		{
+			sd1306_flush_begin(&jobs[i], panels[i], panels[i]->front_frame.pixels, panels[i]->front_frame.first_col,
+				panels[i]->front_frame.last_col, &panels[i]->front_frame.presented, &panels[i]->front_frame.effects);
+		}
+		do
+		{
+			busy = 0;
+			for (i = 0; i < count; i++)
+			{
+				busy |= sd1306_flush_next(&jobs[i]);
+			}
+		} while (busy);
+		for (i = 0; i < count; i++)
+		{
+			sd1306_flush_end(&jobs[i]);
+		}
+		pthread_mutex_lock(&flush_lock);
+	}
+	pthread_mutex_unlock(&flush_lock);
+
+	return NULL;
+}
+
+/**
+  * @brief  Send the changed windows of OLED buffer to OLED RAM of the selected panel
+  * @retval None.
+  * @note   With the flush thread running, only copies OLED buffer for the flush thread and returns.
+  *         A frame the flush thread has not picked up yet is replaced, its changes are kept.
+  */
+void sd1306_refresh(void)
+{
+	struct sd1306_frame* ready = &display->ready_frame;
+	struct timespec now;
+	uint8_t page;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (!flush_running)
+	{
+		sd1306_flush(display, oled_buffer, display->dirty_first_col, display->dirty_last_col, &now, &display->pending_effects);
+		memset(&display->pending_effects, 0, sizeof(display->pending_effects));
+		return;
+	}
+
+	pthread_mutex_lock(&flush_lock);
+	sd1306_kernel_copy(ready->pixels, oled_buffer, BUFFER_SIZE);
+	for (page = 0; page < OLED_PAGES; page++)
+	{
+		if (display->dirty_first_col[page] < ready->first_col[page])
+		{
+			ready->first_col[page] = display->dirty_first_col[page];
+		}
+		if (display->dirty_last_col[page] > ready->last_col[page])
+		{
+			ready->last_col[page] = display->dirty_last_col[page];
+		}
+		display->dirty_first_col[page] = OLED_WIDTH;
+		display->dirty_last_col[page] = 0;
+	}
+	sd1306_merge_effects(&ready->effects, &display->pending_effects);
+	if (!display->ready_pending)
+	{
+		ready->presented = now;
+		display->ready_pending = 1;
+	}
+	pthread_cond_signal(&flush_cond);
+	pthread_mutex_unlock(&flush_lock);
+}
+
+/**
+  * @brief  Start sending refreshes of all panels from a thread of their own
+  * @retval Zero if was succefully, negative if was unsuccefully and refreshes stay synchronous.
   */
-static int32_t  bit_test(uint8_t  data, uint8_t  n)
+int32_t sd1306_start_flush_thread(void)
 {
-	if (n < 0 || n > 7)
+	uint8_t i;
+
+	if (flush_running)
 	{
-		return  0;
+		return 0;
 	}
 
-	if ((data >> (7 - n)) & 0x1)
+	for (i = 0; i < SD1306_MAX_DISPLAYS; i++)
 	{
-		return 1;
+		sd1306_reset_flush_frames(&displays[i]);
 	}
-	else
+	flush_stop = 0;
+
+	if (pthread_create(&flush_thread, NULL, sd1306_flush_loop, NULL) != 0)
 	{
-		return 0;
+		return -1;
 	}
+	flush_running = 1;
+	return 0;
 }
 
 /**
-  * @brief  Draw a string
-  * @param  x: x coordinate of start point
-  * @param  y: y coordinate of start point
-  * @param  textptr: pointer
-  * @param  size: scale
+  * @brief  Send the last frames handed over and stop the flush thread, refreshes are synchronous again
   * @retval None.
   */
-void sd1306_draw_string(int32_t x, int32_t y, uint8_t* textptr, int32_t size, uint8_t color)
+void sd1306_stop_flush_thread(void)
 {
-	// Loop counters
+	struct sd1306_display* panel;
+	uint8_t page;
 	uint8_t i;
-	uint8_t j;
-	uint8_t k;
-	uint8_t l;
-	uint8_t m;
-	// Stores character data
-	uint8_t pixelData[5];
 
-	// Loop through the passed string
-	for (i = 0; textptr[i] != 0x00; ++i, ++x)
+	if (!flush_running)
 	{
-		// Get data font
-		memcpy(pixelData, font_data[textptr[i] - ' '], 5);
+		return;
+	}
 
-		// Performs character wrapping
-		if (x + 5 * size >= 128)
-		{
-			// Set x at far left position
-			x = 0;
-			// Set y at next position down
-			y += 7 * size + 1;
-		}
+	pthread_mutex_lock(&flush_lock);
+	flush_stop = 1;
+	pthread_cond_signal(&flush_cond);
+	pthread_mutex_unlock(&flush_lock);
+	pthread_join(flush_thread, NULL);
+	flush_running = 0;
 
-		// Loop through character byte data
-		for (j = 0; j < 5; ++j, x += size)
+	// OLED buffer is newer than the front frame, so windows that failed to send are resent from it
+	for (i = 0; i < SD1306_MAX_DISPLAYS; i++)
+	{
+		panel = &displays[i];
+		for (page = 0; page < OLED_PAGES && panel->open; page++)
 		{
-			// Loop through the vertical pixels
-			for (k = 0; k < 7 * size; ++k)
+			if (panel->front_frame.first_col[page] < panel->dirty_first_col[page])
 			{
-				// Check if the pixel should be set
-				if (bit_test(BitReverseTable256[pixelData[j]], k))
-				{
-					// The next two loops change the character's size
-					for (l = 0; l < size; ++l)
-					{
-						for (m = 0; m < size; ++m)
-						{
-							// Draws the pixel
-							sd1306_draw_pixel(x + m, y + k * size + l, color);
-						}
-					}
-				}
+				panel->dirty_first_col[page] = panel->front_frame.first_col[page];
+			}
+			if (panel->front_frame.last_col[page] > panel->dirty_last_col[page])
+			{
+				panel->dirty_last_col[page] = panel->front_frame.last_col[page];
 			}
 		}
 	}
 }
 
 /**
-  * @brief  Set the display upside down.
+  * @brief  Forget what OLED RAM of the selected panel holds so next refresh resends the whole buffer
   * @retval None.
   */
-void upside_down(void)
+void sd1306_invalidate(void)
 {
-	// Set OLED upside down
-	sd1306_send_command(sd1306_ADDR, 0xc0);
-	// Set segment from right to left
-	sd1306_send_command(sd1306_ADDR, 0xa0);
+	pthread_mutex_lock(&flush_lock);
+	display->shadow_reset = 1;
+	pthread_mutex_unlock(&flush_lock);
+	sd1306_mark_all_dirty();
 }
 
 /**
-  * @brief  Set the display upside up.
-  * @retval None.
+  * @brief  Open a panel on the bus, or get the one already open at an address
+  * @param  addr: I2C address of the panel
+  * @param  orientation: a sd1306_orientation, applied by sd1306_init
+  * @retval Handle of the panel, NULL if SD1306_MAX_DISPLAYS panels are open.
+  * @note   The panel at sd1306_ADDR is open from the start and selected. Select a new panel and
+  *         call sd1306_init to set it up, its first refresh writes the whole OLED RAM.
   */
-void upside_up(void)
+struct sd1306_display* sd1306_open_display(uint8_t addr, uint8_t orientation)
 {
+	struct sd1306_display* panel = NULL;
+	uint8_t i;
 
-	// Set OLED upside up
-	sd1306_send_command(sd1306_ADDR, 0xc8);
-	// Set segment from left to right
-	sd1306_send_command(sd1306_ADDR, 0xa1);
+	pthread_mutex_lock(&flush_lock);
+	for (i = 0; i < SD1306_MAX_DISPLAYS && panel == NULL; i++)
+	{
+		if (displays[i].open && displays[i].addr == addr)
+		{
+			panel = &displays[i];
+		}
+	}
+	for (i = 0; i < SD1306_MAX_DISPLAYS && panel == NULL; i++)
+	{
+		if (!displays[i].open)
+		{
+			panel = &displays[i];
+			memset(panel, 0, sizeof(*panel));
+			panel->addr = addr;
+			panel->orientation = orientation;
+			memset(panel->dirty_last_col, OLED_WIDTH - 1, sizeof(panel->dirty_last_col));
+			panel->clip_x1 = OLED_WIDTH - 1;
+			panel->clip_y1 = OLED_HEIGHT - 1;
+			memset(panel->clip_page_mask, 0xff, sizeof(panel->clip_page_mask));
+			sd1306_reset_flush_frames(panel);
+			panel->open = 1;
+		}
+	}
+	pthread_mutex_unlock(&flush_lock);
+	return panel;
 }
 
 /**
-  * @brief  Send OLED buffer to OLED RAM
+  * @brief  Make drawing, refreshes and effects act on a panel
+  * @param  panel: panel from sd1306_open_display
   * @retval None.
   */
-void sd1306_refresh(void)
+void sd1306_select_display(struct sd1306_display* panel)
 {
-	// Set the lower comulmn address to zero
-	sd1306_send_command(sd1306_ADDR, 0x00);
-	// Set the higher comulmn address to zero
-	sd1306_send_command(sd1306_ADDR, 0x10);
-	// Set page address to zero
-	sd1306_send_command(sd1306_ADDR, 0xb0);
-	// Send OLED buffer to sd1306 RAM
-	sd1306_write_data(sd1306_ADDR, oled_buffer);
+	display = panel;
+	oled_buffer = &panel->frame[OLED_FRAME_PREFIX];
 }
 
 /**
-  * @brief  Draw a image in OLED buffer
-  * @retval None.
+  * @brief  Get the panel that drawing, refreshes and effects act on
+  * @retval Handle of the selected panel.
   */
-void sd1306_draw_img(uint8_t* ptr_img)
+struct sd1306_display* sd1306_selected_display(void)
 {
-	uint16_t i;
-	for (i = 0; i < BUFFER_SIZE; i++)
+	return display;
+}
+
+/**
+  * @brief  Scroll pages horizontally with the controller, starting with the next refresh.
+  * @param  direction: scroll_right or scroll_left
+  * @param  first_page: first page to scroll
+  * @param  last_page: last page to scroll
+  * @param  interval: frames between scroll steps, a sd1306_scroll_interval
+  * @retval Zero if was succefully, negative if the arguments are out of range.
+  * @note   Refreshes that change the OLED buffer stop the scroll, send the changes and start it
+  *         over from the unscrolled pages. Refreshes without changes leave it running.
+  */
+int32_t sd1306_start_scroll(uint8_t direction, uint8_t first_page, uint8_t last_page, uint8_t interval)
+{
+	struct sd1306_scroll* scroll = &display->pending_effects.scroll;
+	uint8_t i = 0;
+
+	if (first_page > last_page || last_page >= OLED_PAGES || interval > 7)
 	{
-		oled_buffer[i] = ptr_img[i];
+		return -1;
 	}
+
+	// Right or left horizontal scroll, dummy, start page, interval, end page, dummies
+	scroll->commands[i++] = direction == scroll_left ? 0x27 : 0x26;
+	scroll->commands[i++] = 0x00;
+	scroll->commands[i++] = first_page;
+	scroll->commands[i++] = interval;
+	scroll->commands[i++] = last_page;
+	scroll->commands[i++] = 0x00;
+	scroll->commands[i++] = 0xff;
+	// Activate scroll
+	scroll->commands[i++] = 0x2f;
+	scroll->length = i;
+	scroll->first_page = first_page;
+	scroll->last_page = last_page;
+	display->pending_effects.scroll_changed = 1;
+	return 0;
 }
 
 /**
-  * @brief  Set all buffer's bytes to zero
-  * @retval None.
+  * @brief  Scroll pages horizontally and the whole display vertically, starting with the next refresh.
+  * @param  direction: scroll_right or scroll_left
+  * @param  first_page: first page to scroll horizontally
+  * @param  last_page: last page to scroll horizontally
+  * @param  interval: frames between scroll steps, a sd1306_scroll_interval
+  * @param  vertical_offset: rows to scroll up per step, 1 to 63
+  * @retval Zero if was succefully, negative if the arguments are out of range.
   */
-void clear_oled_buffer()
+int32_t sd1306_start_diagonal_scroll(uint8_t direction, uint8_t first_page, uint8_t last_page, uint8_t interval, uint8_t vertical_offset)
 {
-	uint16_t i;
+	struct sd1306_scroll* scroll = &display->pending_effects.scroll;
+	uint8_t i = 0;
 
-	for (i = 0; i < BUFFER_SIZE; i++)
+	if (first_page > last_page || last_page >= OLED_PAGES || interval > 7 ||
+		vertical_offset == 0 || vertical_offset >= OLED_HEIGHT)
 	{
-		oled_buffer[i] = 0;
+		return -1;
 	}
-}
 
+	// Set vertical scroll area, no fixed rows, all rows scroll
+	scroll->commands[i++] = 0xa3;
+	scroll->commands[i++] = 0x00;
+	scroll->commands[i++] = OLED_HEIGHT;
+	// Vertical and right or left horizontal scroll, dummy, start page, interval, end page, offset
+	scroll->commands[i++] = direction == scroll_left ? 0x2a : 0x29;
+	scroll->commands[i++] = 0x00;
+	scroll->commands[i++] = first_page;
+	scroll->commands[i++] = interval;
+	scroll->commands[i++] = last_page;
+	scroll->commands[i++] = vertical_offset;
+	// Activate scroll
+	scroll->commands[i++] = 0x2f;
+	scroll->length = i;
+	scroll->first_page = first_page;
+	scroll->last_page = last_page;
+	display->pending_effects.scroll_changed = 1;
+	return 0;
+}
 
 /**
-  * @brief  Set all buffer's bytes to 0xff
+  * @brief  Stop scrolling with the next refresh, which resends the scrolled pages.
   * @retval None.
   */
+void sd1306_stop_scroll(void)
+{
+	memset(&display->pending_effects.scroll, 0, sizeof(display->pending_effects.scroll));
+	display->pending_effects.scroll_changed = 1;
+}
 
-void fill_oled_buffer()
+/**
+  * @brief  Make the next refresh slide the whole buffer in from the bottom instead of redrawing it.
+  * @param  step_ms: time between the 8 page steps
+  * @retval None.
+  * @note   Each step moves the display start line a page and writes one page, so the slide costs
+  *         one frame of data. Without the flush thread, the refresh blocks for the whole slide.
+  */
+void sd1306_slide_next_refresh(uint32_t step_ms)
 {
-	uint16_t i;
+	display->pending_effects.slide_step_ms = step_ms != 0 ? step_ms : 1;
+}
 
-	for (i = 0; i < BUFFER_SIZE; i++)
+/**
+  * @brief  Get the refresh counters of the selected panel
+  * @param  stats: where to copy the counters
+  * @retval None.
+  */
+void sd1306_get_stats(struct sd1306_stats* stats)
+{
+	pthread_mutex_lock(&flush_lock);
+	*stats = display->refresh_stats;
+	if (display->refresh_stats.frames_sent != 0)
 	{
-		oled_buffer[i] = 0xff;
+		stats->latency_avg_us = (uint32_t)(display->latency_total_us / display->refresh_stats.frames_sent);
 	}
+	pthread_mutex_unlock(&flush_lock);
 }
 
 /**
-  * @brief  Draw an arc given angles (This is jus a test function, not optimized)
-  * @param x: x coordinate of the center
-  * @param y: y coordinate of the center
-  * @param radius: radius of arc
-  * @param a0: start angle
-  * @param a1: end angle
+  * @brief  Draw a image in OLED buffer
   * @retval None.
   */
-void sd1306_draw_arc(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color)
+void sd1306_draw_img(uint8_t* ptr_img)
 {
-	int32_t a, b, P;
-	a = 0x00;
-	b = radius;
-	P = 0x01 - radius;
+	sd1306_kernel_copy(oled_buffer, ptr_img, BUFFER_SIZE);
+	sd1306_mark_all_dirty();
+}
+
+/**
+  * @brief  Put a decoded page row of a packed image in OLED buffer
+  * @param  x: x coordinate of the row
+  * @param  y: y coordinate of the row
+  * @param  row: column bytes of the row
+  * @param  width: row width
+  * @retval None.
+  */
+static void sd1306_put_packed_row(int32_t x, int32_t y, const uint8_t* row, int32_t width)
+{
+	// Page aligned rows inside the clip rectangle go straight into OLED buffer
+	if ((y & 7) == 0 && x >= display->clip_x0 && x + width - 1 <= display->clip_x1 && y >= display->clip_y0 && y + 7 <= display->clip_y1)
+	{
+		sd1306_kernel_copy(&oled_buffer[x + (y / 8) * OLED_WIDTH], row, width);
+		return;
+	}
 
-	int32_t angle;
+	sd1306_fill_area(x, y, x + width - 1, y + 7, black_pixel);
+	SD1306_ROP_CALL(white_pixel, sd1306_glyph, x, y, row, width, 8);
+}
 
-	do
+/**
+  * @brief  Draw a packed image in OLED buffer, decoding it a page row at a time
+  * @param  x: x coordinate of the image
+  * @param  y: y coordinate of the image
+  * @param  packed: image made by tools/imgpack
+  * @param  length: bytes in packed
+  * @retval Zero if was succefully, negative if the image is malformed.
+  * @note   After the header come runs over the page rows, a control byte c < 0x80 followed by
+  *         c + 1 literal bytes, or c >= 0x80 followed by one byte repeated (c & 0x7f) + 2 times.
+  *         The image replaces what was under it. A malformed image is drawn up to the error.
+  */
+int32_t sd1306_draw_packed_img(int32_t x, int32_t y, const uint8_t* packed, uint32_t length)
+{
+	// Rows are decoded into these in turn when they cannot go straight into OLED buffer
+	uint8_t rows[2][OLED_WIDTH];
+	uint8_t* row;
+	const uint8_t* above = NULL;
+	const uint8_t* literal = NULL;
+	uint32_t in = SD1306_PACKED_HEADER;
+	int32_t width;
+	int32_t pages;
+	int32_t page = 0;
+	int32_t filled = 0;
+	int32_t count;
+	int32_t n;
+	uint8_t value = 0;
+	uint8_t xor_delta;
+	uint8_t direct;
+
+	if (length < SD1306_PACKED_HEADER)
 	{
+		return -1;
+	}
+	width = packed[0];
+	pages = packed[1];
+	xor_delta = packed[2] & SD1306_PACKED_XOR_DELTA;
+	if (width == 0 || width > OLED_WIDTH || pages == 0 || pages > OLED_PAGES)
+	{
+		return -1;
+	}
 
+	sd1306_mark_dirty(x, y, x + width - 1, y + pages * 8 - 1);
 
-		angle = atan2f(b, a) * 180.0 / 3.14;
+	// A page aligned image inside the clip rectangle is decoded in place
+	direct = (y & 7) == 0 && x >= display->clip_x0 && x + width - 1 <= display->clip_x1 && y >= display->clip_y0 && y + pages * 8 - 1 <= display->clip_y1;
+	row = direct ? &oled_buffer[x + (y / 8) * OLED_WIDTH] : rows[0];
 
-		angle < 0 ? angle += 360 : angle;
+	while (page < pages)
+	{
+		if (in >= length)
+		{
+			return -1;
+		}
 
-		if (a1 > a0)
+		if (packed[in] & 0x80)
 		{
-			if (angle >= a0 && angle <= a1)
+			count = (packed[in] & 0x7f) + 2;
+			if (in + 1 >= length)
 			{
-				sd1306_draw_pixel(a + x, y - b, color);
+				return -1;
 			}
+			value = packed[in + 1];
+			literal = NULL;
+			in += 2;
 		}
 		else
 		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+			count = packed[in] + 1;
+			if (in + 1 + count > length)
 			{
-				sd1306_draw_pixel(a + x, y - b, color);
+				return -1;
 			}
+			literal = &packed[in + 1];
+			in += 1 + count;
 		}
 
-
-
-		angle = atan2f(a, b) * 180.0 / 3.14;
-
-		angle < 0 ? angle += 360 : angle;
-
-		if (a1 > a0)
+		// A run can go on into the next page rows
+		while (count > 0)
 		{
-			if (angle >= a0 && angle <= a1)
+			if (page == pages)
 			{
-				sd1306_draw_pixel(b + x, y - a, color);
+				return -1;
 			}
-		}
-		else
-		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+
+			n = count < width - filled ? count : width - filled;
+			if (literal != NULL)
+			{
+				memcpy(&row[filled], literal, n);
+				literal += n;
+			}
+			else
+			{
+				memset(&row[filled], value, n);
+			}
+			filled += n;
+			count -= n;
+
+			if (filled == width)
 			{
-				sd1306_draw_pixel(b + x, y - a, color);
+				if (xor_delta && above != NULL)
+				{
+					sd1306_kernel_xor(row, above, width);
+				}
+				if (!direct)
+				{
+					sd1306_put_packed_row(x, y + page * 8, row, width);
+				}
+				above = row;
+				filled = 0;
+				page++;
+				row = direct ? row + OLED_WIDTH : rows[page & 1];
 			}
 		}
+	}
+	return 0;
+}
 
+/**
+  * @brief  Set all buffer's bytes to zero
+  * @retval None.
+  */
+void clear_oled_buffer()
+{
+	sd1306_kernel_fill(oled_buffer, 0x00, BUFFER_SIZE);
+	sd1306_mark_all_dirty();
+}
 
 
-		angle = atan2f(b, -a) * 180.0 / 3.14;
+/**
+  * @brief  Set all buffer's bytes to 0xff
+  * @retval None.
+  */
 
-		angle < 0 ? angle += 360 : angle;
+void fill_oled_buffer()
+{
+	sd1306_kernel_fill(oled_buffer, 0xff, BUFFER_SIZE);
+	sd1306_mark_all_dirty();
+}
 
-		if (a1 > a0)
-		{
-			if (angle >= a0 && angle <= a1)
-			{
-				sd1306_draw_pixel(x - a, y - b, color);
-			}
-		}
-		else
-		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
-			{
-				sd1306_draw_pixel(x - a, y - b, color);
-			}
-		}
+// sin of 0 to 90 degrees scaled by 16384, for the arc boundary directions
+static const int16_t SinTable91[] =
+{
+	0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+	2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+	5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+	8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+	12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+	14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+	15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+	16384,
+};
 
+/**
+  * @brief  Direction of an angle from the sin table
+  * @param  angle: angle in degrees, 0 to 359
+  * @param  dx: cos of angle scaled by 16384
+  * @param  dy: sin of angle scaled by 16384
+  * @retval None.
+  */
+static void sd1306_arc_direction(int32_t angle, int32_t* dx, int32_t* dy)
+{
+	int32_t quadrant = angle / 90;
+	int32_t rest = angle % 90;
+	int32_t s = SinTable91[rest];
+	int32_t c = SinTable91[90 - rest];
 
-		angle = atan2f(a, -b) * 180.0 / 3.14;
+	switch (quadrant)
+	{
+	case 0:
+		*dx = c;
+		*dy = s;
+		break;
+	case 1:
+		*dx = -s;
+		*dy = c;
+		break;
+	case 2:
+		*dx = -c;
+		*dy = -s;
+		break;
+	default:
+		*dx = s;
+		*dy = -c;
+		break;
+	}
+}
 
-		angle < 0 ? angle += 360 : angle;
+/**
+  * @brief  Work out boundary directions and octant coverage of an arc
+  * @param  arc: arc to set up
+  * @param  a0: start angle
+  * @param  a1: end angle
+  * @retval None.
+  */
+static void sd1306_arc_setup(struct sd1306_arc* arc, int32_t a0, int32_t a1)
+{
+	int32_t octant;
+	int32_t lo;
+	int32_t hi;
+
+	arc->a0 = ((a0 % 360) + 360) % 360;
+	arc->a1 = ((a1 % 360) + 360) % 360;
+	// An end angle of 360 means all the way round
+	if (a1 > a0 && arc->a1 <= arc->a0)
+	{
+		arc->a1 += 360;
+	}
+	arc->wrap = arc->a1 <= arc->a0;
+	sd1306_arc_direction(arc->a0, &arc->a0_x, &arc->a0_y);
+	sd1306_arc_direction(arc->a1 % 360, &arc->a1_x, &arc->a1_y);
 
-		if (a1 > a0)
+	for (octant = 0; octant < 8; octant++)
+	{
+		lo = octant * 45;
+		hi = lo + 45;
+		if (arc->wrap)
 		{
-			if (angle >= a0 && angle <= a1)
+			if (arc->a0 <= lo || arc->a1 >= hi)
 			{
-				sd1306_draw_pixel(x - b, y - a, color);
+				arc->octant[octant] = octant_inside;
 			}
-		}
-		else
-		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+			else if (arc->a0 > hi && arc->a1 < lo)
 			{
-				sd1306_draw_pixel(x - b, y - a, color);
+				arc->octant[octant] = octant_outside;
 			}
-		}
-
-
-		angle = atan2f(-a, b) * 180.0 / 3.14;
-
-		angle < 0 ? angle += 360 : angle;
-
-		if (a1 > a0)
-		{
-			if (angle >= a0 && angle <= a1)
+			else
 			{
-				sd1306_draw_pixel(b + x, y + a, color);
+				arc->octant[octant] = octant_partial;
 			}
 		}
 		else
 		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+			if (arc->a0 <= lo && arc->a1 >= hi)
 			{
-				sd1306_draw_pixel(b + x, y + a, color);
+				arc->octant[octant] = octant_inside;
 			}
-		}
-
-
-
-		angle = atan2f(-b, a) * 180.0 / 3.14;
-
-		angle < 0 ? angle += 360 : angle;
-
-		if (a1 > a0)
-		{
-			if (angle >= a0 && angle <= a1)
+			else if (arc->a1 < lo || arc->a0 > hi)
 			{
-				sd1306_draw_pixel(a + x, y + b, color);
+				arc->octant[octant] = octant_outside;
 			}
-		}
-		else
-		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+			else
 			{
-				sd1306_draw_pixel(a + x, y + b, color);
+				arc->octant[octant] = octant_partial;
 			}
 		}
+	}
+}
+
+/**
+  * @brief  Octant of a point around the center
+  * @param  dx: x offset from the center
+  * @param  dy: y offset from the center, up is positive
+  * @retval Octant, 0 is 0 to 45 degrees.
+  */
+static int32_t sd1306_arc_octant(int32_t dx, int32_t dy)
+{
+	if (dy >= 0 && dx > 0)
+	{
+		return dy <= dx ? 0 : 1;
+	}
+	if (dx <= 0 && dy > 0)
+	{
+		return -dx <= dy ? 2 : 3;
+	}
+	if (dy <= 0 && dx < 0)
+	{
+		return -dy <= -dx ? 4 : 5;
+	}
+	return dx <= -dy ? 6 : 7;
+}
 
+/**
+  * @brief  Draw an arc given angles
+  * @param x: x coordinate of the center
+  * @param y: y coordinate of the center
+  * @param radius: radius of arc
+  * @param a0: start angle, degrees counterclockwise from 3 o'clock
+  * @param a1: end angle, the arc wraps through 0 when it is not greater than a0
+  * @retval None.
+  */
+void sd1306_draw_arc(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color)
+{
+	struct sd1306_arc arc;
 
+	sd1306_arc_setup(&arc, a0, a1);
+	sd1306_mark_dirty(x - radius, y - radius, x + radius, y + radius);
 
-		angle = atan2f(-b, -a) * 180.0 / 3.14;
+	// Only arcs whose circle crosses the clip rectangle edges check their pixels
+	if (sd1306_clip_holds(x - radius, y - radius, x + radius, y + radius))
+	{
+		SD1306_ROP_CALL(color, sd1306_arc_points, x, y, radius, &arc, 0);
+	}
+	else
+	{
+		SD1306_ROP_CALL(color, sd1306_arc_points, x, y, radius, &arc, 1);
+	}
+}
+
+/**
+  * @brief  Draw a filled circle sector given angles
+  * @param x: x coordinate of the center
+  * @param y: y coordinate of the center
+  * @param radius: radius of the sector
+  * @param a0: start angle, degrees counterclockwise from 3 o'clock
+  * @param a1: end angle, the sector wraps through 0 when it is not greater than a0
+  * @retval None.
+  */
+void sd1306_draw_pie(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color)
+{
+	struct sd1306_arc arc;
+	int32_t dx;
+	int32_t dy;
+	int32_t width = radius;
+	int32_t run;
 
-		angle < 0 ? angle += 360 : angle;
+	sd1306_arc_setup(&arc, a0, a1);
 
-		if (a1 > a0)
+	// Scanlines from the top, dy grows upwards
+	for (dy = radius; dy >= -radius; dy--)
+	{
+		// Half width of the circle on this scanline, shrinks towards the top and bottom
+		width = radius;
+		while (width > 0 && width * width + dy * dy > radius * radius + radius)
 		{
-			if (angle >= a0 && angle <= a1)
-			{
-				sd1306_draw_pixel(x - a, y + b, color);
-			}
+			width--;
 		}
-		else
+		if (y - dy < 0 || y - dy >= OLED_HEIGHT)
 		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
-			{
-				sd1306_draw_pixel(x - a, y + b, color);
-			}
+			continue;
 		}
 
-
-
-		angle = atan2f(-a, -b) * 180.0 / 3.14;
-
-		angle < 0 ? angle += 360 : angle;
-
-		if (a1 > a0)
+		// Emit runs of points inside the angles as spans
+		run = -width - 1;
+		for (dx = -width; dx <= width + 1; dx++)
 		{
-			if (angle >= a0 && angle <= a1)
+			uint8_t inside = dx <= width &&
+				((dx == 0 && dy == 0) || sd1306_arc_contains(&arc, dx, dy, sd1306_arc_octant(dx, dy)));
+			if (inside && run < -width)
 			{
-				sd1306_draw_pixel(x - b, y + a, color);
+				run = dx;
 			}
-		}
-		else
-		{
-			if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+			else if (!inside && run >= -width)
 			{
-				sd1306_draw_pixel(x - b, y + a, color);
+				sd1306_fill_area(x + run, y - dy, x + dx - 1, y - dy, color);
+				run = -width - 1;
 			}
 		}
-
-		if (P < 0)
-		{
-			P += 3 + 2 * a++;
-		}
-		else
-		{
-			P += 5 + 2 * (a++ - b--);
-		}
-
-	} while (a <= b);
-}
\ No newline at end of file
+	}
+}
@@ -5,22 +5,50 @@
 
 
 #include <stdint.h>
-#include "i2c.h"
-#include <applibs/i2c.h>
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
 
 #define sd1306_ADDR 0x3c
 
+// Panels that can be open at once on the bus
+#ifndef SD1306_MAX_DISPLAYS
+#define SD1306_MAX_DISPLAYS 2
+#endif
+
 
 #define OLED_HEIGHT 64
 #define OLED_WIDTH  128
 #define BUFFER_SIZE OLED_HEIGHT*OLED_WIDTH/8
+#define OLED_PAGES  (OLED_HEIGHT / 8)
+
+// Longest command sequence sd1306_send_command_list accepts
+#define SD1306_MAX_COMMAND_LIST 64
+
+// Packed images made by tools/imgpack start with width, pages and flags
+#define SD1306_PACKED_HEADER 3
+// Flag of packed images whose page rows are stored XORed with the row above
+#define SD1306_PACKED_XOR_DELTA 0x01
 
 #define _swap(a, b) (((a) ^= (b)), ((b) ^= (a)), ((a) ^= (b))) 
 
+struct sd1306_stats
+{
+	// Refreshes that found changes and wrote them to OLED RAM
+	uint32_t frames_sent;
+	// Refreshes that found nothing changed and did not touch the bus
+	uint32_t frames_skipped;
+	// Data bytes written to OLED RAM, without control bytes and commands
+	uint32_t bytes_sent;
+	// Time from sd1306_refresh until the frame is in OLED RAM, of the frames sent
+	uint32_t latency_min_us;
+	uint32_t latency_avg_us;
+	uint32_t latency_max_us;
+};
+
 enum pixelcolor
 {
 	black_pixel,
@@ -28,6 +56,79 @@ enum pixelcolor
 	inverse_pixel,
 };
 
+enum sd1306_scroll_direction
+{
+	scroll_right,
+	scroll_left,
+};
+
+// Frames between hardware scroll steps, values are the controller's encoding
+enum sd1306_scroll_interval
+{
+	scroll_5_frames,
+	scroll_64_frames,
+	scroll_128_frames,
+	scroll_256_frames,
+	scroll_3_frames,
+	scroll_4_frames,
+	scroll_25_frames,
+	scroll_2_frames,
+};
+
+enum sd1306_orientation
+{
+	orientation_upside_up,
+	orientation_upside_down,
+};
+
+// A panel on the bus with its own OLED buffer, address and orientation
+struct sd1306_display;
+
+// Where the bytes for the panel go. Every transfer starts with the control byte, 0x00 for commands
+// or 0x40 for RAM data, followed by the payload, just as an I2C write to the controller.
+struct sd1306_backend
+{
+	// Send a transfer to the panel at addr, negative on failure
+	int32_t (*write)(void* context, uint8_t addr, const uint8_t* bytes, uint16_t length);
+	// Called once a refresh wrote a frame to the panel, may be NULL
+	void (*frame_done)(void* context);
+	void* context;
+};
+
+// SSD1306 on the I2C bus opened by initI2c
+extern const struct sd1306_backend sd1306_i2c_backend;
+
+/**
+  * @brief  Choose where transfers to the panel go.
+  * @param  backend: backend to use, it must stay valid while in use
+  * @retval None.
+  * @note   Call before sd1306_init and while the flush thread is stopped.
+  */
+extern void sd1306_set_backend(const struct sd1306_backend* backend);
+
+/**
+  * @brief  Open a panel on the bus, or get the one already open at an address
+  * @param  addr: I2C address of the panel
+  * @param  orientation: a sd1306_orientation, applied by sd1306_init
+  * @retval Handle of the panel, NULL if SD1306_MAX_DISPLAYS panels are open.
+  * @note   The panel at sd1306_ADDR is open from the start and selected. Select a new panel and
+  *         call sd1306_init to set it up, its first refresh writes the whole OLED RAM.
+  */
+extern struct sd1306_display* sd1306_open_display(uint8_t addr, uint8_t orientation);
+
+/**
+  * @brief  Make drawing, refreshes and effects act on a panel
+  * @param  panel: panel from sd1306_open_display
+  * @retval None.
+  */
+extern void sd1306_select_display(struct sd1306_display* panel);
+
+/**
+  * @brief  Get the panel that drawing, refreshes and effects act on
+  * @retval Handle of the selected panel.
+  */
+extern struct sd1306_display* sd1306_selected_display(void);
+
 /**
   * @brief  Initialize sd1306.
   * @param  None.
@@ -35,6 +136,15 @@ enum pixelcolor
   */
 extern uint8_t sd1306_init(void);
 
+/**
+  * @brief  Send a sequence of commands to sd1306 in one I2C transaction.
+  * @param  addr: address of device
+  * @param  cmds: commands and their arguments
+  * @param  count: number of bytes in cmds, at most SD1306_MAX_COMMAND_LIST
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  */
+extern int32_t sd1306_send_command_list(uint8_t addr, const uint8_t* cmds, uint8_t count);
+
 /**
   * @brief  Draw a pixel at specified coordinates
   * @param  x: x coordinate
@@ -43,6 +153,22 @@ extern uint8_t sd1306_init(void);
   */
 void sd1306_draw_pixel(int32_t x, int32_t y, uint8_t color);
 
+/**
+  * @brief  Set the clip rectangle, primitives only draw inside it and the OLED matrix
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @retval None.
+  */
+extern void sd1306_set_clip(int32_t x, int32_t y, int32_t width, int32_t height);
+
+/**
+  * @brief  Reset the clip rectangle to the whole OLED matrix
+  * @retval None.
+  */
+extern void sd1306_reset_clip(void);
+
 /**
   * @brief  Draw a line
   * @param  x1: x coordinate of start point
@@ -91,6 +217,16 @@ extern void sd1306_draw_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height
   */
 extern void sd1306_draw_fill_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color);
 
+/**
+  * @brief  Clear a rectangle of OLED buffer given start point, width and height
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: rectangle width
+  * @param  height: rectangle height
+  * @retval None.
+  */
+extern void sd1306_clear_rect(int32_t x, int32_t y, int32_t width, int32_t height);
+
 /**
   * @brief  Draw a rounded rectangle given start point, width and height
   * @param  x: x coordinate
@@ -165,6 +301,39 @@ extern void sd1306_draw_fill_triangle(uint8_t x0, uint8_t y0, uint8_t x1, uint8_
   */
 extern void sd1306_draw_string(int32_t x, int32_t y, uint8_t* textptr, int32_t size, uint8_t color);
 
+/**
+  * @brief  Draw a string at size 4 with the large digit face for digits, colon and space
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  textptr: pointer
+  * @retval None.
+  */
+extern void sd1306_draw_large_digits(int32_t x, int32_t y, uint8_t* textptr, uint8_t color);
+
+/**
+  * @brief  Render a string into a page native bitmap instead of OLED buffer, without wrapping
+  * @param  columns: bitmap, pages rows of width bytes, cleared first
+  * @param  width: bitmap width, characters past it are cut off
+  * @param  height: bitmap height, at most 64
+  * @param  textptr: pointer
+  * @param  size: scale
+  * @param  large_digits: draw digits, colon and space with the large digit face, size must be 4
+  * @retval Width of the rendered string.
+  */
+extern int32_t sd1306_render_string_columns(uint8_t* columns, int32_t width, int32_t height, const uint8_t* textptr, int32_t size, uint8_t large_digits);
+
+/**
+  * @brief  Draw a page native bitmap, page rows of column bytes with bit 0 the top row of the page
+  * @param  x: x coordinate of the bitmap
+  * @param  y: y coordinate of the bitmap
+  * @param  columns: pages rows of width bytes
+  * @param  width: bitmap width
+  * @param  height: bitmap height, at most 64
+  * @param  color: pixel color
+  * @retval None.
+  */
+extern void sd1306_draw_columns(int32_t x, int32_t y, const uint8_t* columns, int32_t width, int32_t height, uint8_t color);
+
 /**
   * @brief  Used to do round rectangles
   * @param  x0: x center coordinate
@@ -183,6 +352,7 @@ void sd1306_draw_circle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t c
   * @param  cornername: corner to draw the semicircle
   * @param  delta:
   * @retval None.
+  * @note   The center column is left to the caller.
   */
 void sd1306_draw_fillcircle_helper(uint8_t x0, uint8_t y0, uint8_t radius, uint8_t cornername, uint8_t delta, uint8_t color);
 
@@ -199,17 +369,90 @@ extern void upside_up(void);
 extern void upside_down(void);
 
 /**
-  * @brief  Send OLED buffer to OLED RAM
+  * @brief  Send the changed windows of OLED buffer to OLED RAM of the selected panel
   * @retval None.
+  * @note   With the flush thread running, only copies OLED buffer for the flush thread and returns.
   */
 extern void sd1306_refresh(void);
 
+/**
+  * @brief  Scroll pages horizontally with the controller, starting with the next refresh.
+  * @param  direction: scroll_right or scroll_left
+  * @param  first_page: first page to scroll
+  * @param  last_page: last page to scroll
+  * @param  interval: frames between scroll steps, a sd1306_scroll_interval
+  * @retval Zero if was succefully, negative if the arguments are out of range.
+  * @note   Refreshes that change the OLED buffer stop the scroll, send the changes and start it
+  *         over from the unscrolled pages. Refreshes without changes leave it running.
+  */
+extern int32_t sd1306_start_scroll(uint8_t direction, uint8_t first_page, uint8_t last_page, uint8_t interval);
+
+/**
+  * @brief  Scroll pages horizontally and the whole display vertically, starting with the next refresh.
+  * @param  direction: scroll_right or scroll_left
+  * @param  first_page: first page to scroll horizontally
+  * @param  last_page: last page to scroll horizontally
+  * @param  interval: frames between scroll steps, a sd1306_scroll_interval
+  * @param  vertical_offset: rows to scroll up per step, 1 to 63
+  * @retval Zero if was succefully, negative if the arguments are out of range.
+  */
+extern int32_t sd1306_start_diagonal_scroll(uint8_t direction, uint8_t first_page, uint8_t last_page, uint8_t interval, uint8_t vertical_offset);
+
+/**
+  * @brief  Stop scrolling with the next refresh, which resends the scrolled pages.
+  * @retval None.
+  */
+extern void sd1306_stop_scroll(void);
+
+/**
+  * @brief  Make the next refresh slide the whole buffer in from the bottom instead of redrawing it.
+  * @param  step_ms: time between the 8 page steps
+  * @retval None.
+  */
+extern void sd1306_slide_next_refresh(uint32_t step_ms);
+
+/**
+  * @brief  Start sending refreshes of all panels from a thread of their own
+  * @retval Zero if was succefully, negative if was unsuccefully and refreshes stay synchronous.
+  */
+extern int32_t sd1306_start_flush_thread(void);
+
+/**
+  * @brief  Send the last frames handed over and stop the flush thread, refreshes are synchronous again
+  * @retval None.
+  */
+extern void sd1306_stop_flush_thread(void);
+
+/**
+  * @brief  Forget what OLED RAM of the selected panel holds so next refresh resends the whole buffer
+  * @retval None.
+  */
+extern void sd1306_invalidate(void);
+
+/**
+  * @brief  Get the refresh counters of the selected panel
+  * @param  stats: where to copy the counters
+  * @retval None.
+  */
+extern void sd1306_get_stats(struct sd1306_stats* stats);
+
 /**
   * @brief  Draw a image in OLED buffer
   * @retval None.
   */
 extern void sd1306_draw_img(uint8_t* ptr_img);
 
+/**
+  * @brief  Draw a packed image in OLED buffer, decoding it a page row at a time
+  * @param  x: x coordinate of the image
+  * @param  y: y coordinate of the image
+  * @param  packed: image made by tools/imgpack
+  * @param  length: bytes in packed
+  * @retval Zero if was succefully, negative if the image is malformed.
+  * @note   The image replaces what was under it and is cut by the clip rectangle.
+  */
+extern int32_t sd1306_draw_packed_img(int32_t x, int32_t y, const uint8_t* packed, uint32_t length);
+
 /**
   * @brief  Set all buffer's bytes to zero
   * @retval None.
@@ -223,16 +466,27 @@ extern void clear_oled_buffer(void);
 extern void fill_oled_buffer(void);
 
 /**
-  * @brief  Draw an arc given angles (This is jus a test function, not optimized)
+  * @brief  Draw an arc given angles
   * @param x: x coordinate of the center
   * @param y: y coordinate of the center
   * @param radius: radius of arc
-  * @param a0: start angle
-  * @param a1: end angle
+  * @param a0: start angle, degrees counterclockwise from 3 o'clock
+  * @param a1: end angle, the arc wraps through 0 when it is not greater than a0
   * @retval None.
   */
 extern void sd1306_draw_arc(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color);
 
+/**
+  * @brief  Draw a filled circle sector given angles
+  * @param x: x coordinate of the center
+  * @param y: y coordinate of the center
+  * @param radius: radius of the sector
+  * @param a0: start angle, degrees counterclockwise from 3 o'clock
+  * @param a1: end angle, the sector wraps through 0 when it is not greater than a0
+  * @retval None.
+  */
+extern void sd1306_draw_pie(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color);
+
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,446 @@
+/***************************************************************************************************
+   Name: sd1306_benchmark.c
+   Sphere OS: 19.05
+****************************************************************************************************/
+
+#include <time.h>
+#ifdef SD1306_HOST
+#include <stdio.h>
+#define Log_Debug printf
+#else
+#include <applibs/log.h>
+#endif
+#include "sd1306.h"
+#include "sd1306_benchmark.h"
+#include "sd1306_kernels.h"
+#include "splash_img.h"
+
+#define BENCHMARK_ITERATIONS 200
+// Iterations of the cases that go out to the display, each can take a whole frame time
+#define BENCHMARK_BUS_ITERATIONS 20
+
+// Defined in font.h, which can only be included by sd1306.c
+extern const uint8_t font_data[145][5];
+// Defined in sd1306.c
+extern uint8_t* oled_buffer;
+
+// A timed call of a public sd1306 function
+struct benchmark_case
+{
+	const char* function;
+	// Parameters, the mix main.c uses where it uses the function
+	const char* parameters;
+	// Called with the iteration number
+	void (*run)(uint32_t i);
+	uint32_t iterations;
+	// Pixels an op writes, 0 to count the pixels one op lights in a cleared buffer
+	uint32_t pixels;
+};
+
+/**
+  * @brief  Nanoseconds between two CLOCK_MONOTONIC readings.
+  * @param  start: first reading
+  * @param  end: second reading
+  * @retval Elapsed nanoseconds.
+  */
+static int64_t elapsed_ns(const struct timespec* start, const struct timespec* end)
+{
+	return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000 + (end->tv_nsec - start->tv_nsec);
+}
+
+/**
+  * @brief  Draw a string one pixel at a time, the way sd1306_draw_string used to.
+  * @param  x: x coordinate of start point
+  * @param  y: y coordinate of start point
+  * @param  textptr: pointer
+  * @param  size: scale
+  * @retval None.
+  */
+static void reference_draw_string(int32_t x, int32_t y, uint8_t* textptr, int32_t size, uint8_t color)
+{
+	uint8_t i;
+	uint8_t j;
+	uint8_t k;
+	uint8_t l;
+	uint8_t m;
+	const uint8_t* pixelData;
+
+	for (i = 0; textptr[i] != 0x00; ++i, ++x)
+	{
+		pixelData = font_data[textptr[i] - ' '];
+
+		if (x + 5 * size >= 128)
+		{
+			x = 0;
+			y += 7 * size + 1;
+		}
+
+		for (j = 0; j < 5; ++j, x += size)
+		{
+			for (k = 0; k < 7 * size; ++k)
+			{
+				if (k < 8 && ((pixelData[j] >> k) & 0x1))
+				{
+					for (l = 0; l < size; ++l)
+					{
+						for (m = 0; m < size; ++m)
+						{
+							sd1306_draw_pixel(x + m, y + k * size + l, color);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+  * @brief  Draw one point of the reference arc if atan2f puts it inside the angles.
+  * @param  x: x coordinate of the point
+  * @param  y: y coordinate of the point
+  * @param  dy: y offset from the center, up is positive
+  * @param  dx: x offset from the center
+  * @param  a0: start angle
+  * @param  a1: end angle
+  * @retval None.
+  */
+static void reference_arc_point(int32_t x, int32_t y, int32_t dy, int32_t dx, int32_t a0, int32_t a1, uint8_t color)
+{
+	int32_t angle = atan2f(dy, dx) * 180.0 / 3.14;
+
+	angle < 0 ? angle += 360 : angle;
+
+	if (a1 > a0)
+	{
+		if (angle >= a0 && angle <= a1)
+		{
+			sd1306_draw_pixel(x, y, color);
+		}
+	}
+	else
+	{
+		if ((angle >= a0 && angle < 360) || (angle <= a1 && angle >= 0))
+		{
+			sd1306_draw_pixel(x, y, color);
+		}
+	}
+}
+
+/**
+  * @brief  Draw an arc with atan2f for every point, the way sd1306_draw_arc used to.
+  * @param x: x coordinate of the center
+  * @param y: y coordinate of the center
+  * @param radius: radius of arc
+  * @param a0: start angle
+  * @param a1: end angle
+  * @retval None.
+  */
+static void reference_draw_arc(int32_t x, int32_t y, int32_t radius, int32_t a0, int32_t a1, uint8_t color)
+{
+	int32_t a, b, P;
+	a = 0x00;
+	b = radius;
+	P = 0x01 - radius;
+
+	do
+	{
+		reference_arc_point(a + x, y - b, b, a, a0, a1, color);
+		reference_arc_point(b + x, y - a, a, b, a0, a1, color);
+		reference_arc_point(x - a, y - b, b, -a, a0, a1, color);
+		reference_arc_point(x - b, y - a, a, -b, a0, a1, color);
+		reference_arc_point(b + x, y + a, -a, b, a0, a1, color);
+		reference_arc_point(a + x, y + b, -b, a, a0, a1, color);
+		reference_arc_point(x - a, y + b, -b, -a, a0, a1, color);
+		reference_arc_point(x - b, y + a, -a, -b, a0, a1, color);
+
+		if (P < 0)
+		{
+			P += 3 + 2 * a++;
+		}
+		else
+		{
+			P += 5 + 2 * (a++ - b--);
+		}
+	} while (a <= b);
+}
+
+/**
+  * @brief  Compare per pixel and byte column string drawing at sizes 1 to 4.
+  * @retval None.
+  */
+static void benchmark_draw_string(void)
+{
+	struct timespec start;
+	struct timespec end;
+	long long reference_ns;
+	long long blitter_ns;
+	int32_t size;
+	uint32_t i;
+
+	for (size = 1; size <= 4; size++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		{
+			reference_draw_string(0, 0, (uint8_t*)"12:34", size, white_pixel);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		reference_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+		{
+			sd1306_draw_string(0, 0, (uint8_t*)"12:34", size, white_pixel);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		blitter_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+		Log_Debug("Benchmark: sd1306_draw_string size %d: per pixel %lld ns, byte column %lld ns, %lld.%02lldx\n",
+			size, reference_ns, blitter_ns, reference_ns / (blitter_ns ? blitter_ns : 1),
+			(reference_ns * 100 / (blitter_ns ? blitter_ns : 1)) % 100);
+	}
+}
+
+/**
+  * @brief  Compare atan2f and integer octant arc drawing for a progress ring.
+  * @retval None.
+  */
+static void benchmark_draw_arc(void)
+{
+	struct timespec start;
+	struct timespec end;
+	long long reference_ns;
+	long long integer_ns;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		reference_draw_arc(64, 32, 30, 90, (i * 7) % 360, white_pixel);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	reference_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		sd1306_draw_arc(64, 32, 30, 90, (i * 7) % 360, white_pixel);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	integer_ns = elapsed_ns(&start, &end) / BENCHMARK_ITERATIONS;
+
+	Log_Debug("Benchmark: sd1306_draw_arc radius 30: atan2f %lld ns, integer %lld ns, %lld.%02lldx\n",
+		reference_ns, integer_ns, reference_ns / (integer_ns ? integer_ns : 1),
+		(reference_ns * 100 / (integer_ns ? integer_ns : 1)) % 100);
+}
+
+static uint8_t bench_columns[BUFFER_SIZE];
+static uint8_t bench_image[BUFFER_SIZE];
+
+static void bench_draw_pixel(uint32_t i) { sd1306_draw_pixel(i & 127, (i >> 7) & 63, white_pixel); }
+static void bench_draw_line(uint32_t i) { (void)i; sd1306_draw_line(0, 0, 127, 63, white_pixel); }
+static void bench_draw_fast_Hline(uint32_t i) { (void)i; sd1306_draw_fast_Hline(0, 20, 128, white_pixel); }
+static void bench_draw_fast_Vline(uint32_t i) { (void)i; sd1306_draw_fast_Vline(64, 0, 64, white_pixel); }
+static void bench_draw_rect(uint32_t i) { (void)i; sd1306_draw_rect(0, 0, 128, 64, white_pixel); }
+static void bench_draw_fill_rect(uint32_t i) { (void)i; sd1306_draw_fill_rect(0, 48, 128, 16, white_pixel); }
+static void bench_clear_rect(uint32_t i) { (void)i; sd1306_clear_rect(0, 0, OLED_WIDTH, 32); }
+static void bench_draw_round_rect(uint32_t i) { (void)i; sd1306_draw_round_rect(0, 0, 128, 64, 8, white_pixel); }
+static void bench_draw_fillround_Rect(uint32_t i) { (void)i; sd1306_draw_fillround_Rect(0, 0, 128, 32, 8, white_pixel); }
+static void bench_draw_circle_helper(uint32_t i) { (void)i; sd1306_draw_circle_helper(32, 32, 20, 0x0f, white_pixel); }
+static void bench_draw_fillcircle_helper(uint32_t i) { (void)i; sd1306_draw_fillcircle_helper(32, 32, 20, 0x03, 0, white_pixel); }
+static void bench_draw_circle(uint32_t i) { (void)i; sd1306_draw_circle(64, 32, 30, white_pixel); }
+static void bench_draw_fill_circle(uint32_t i) { (void)i; sd1306_draw_fill_circle(64, 32, 30, white_pixel); }
+static void bench_draw_triangle(uint32_t i) { (void)i; sd1306_draw_triangle(0, 63, 64, 0, 127, 63, white_pixel); }
+static void bench_draw_fill_triangle(uint32_t i) { (void)i; sd1306_draw_fill_triangle(0, 63, 64, 0, 127, 63, white_pixel); }
+static void bench_draw_arc(uint32_t i) { (void)i; sd1306_draw_arc(64, 32, 30, 90, 330, white_pixel); }
+static void bench_draw_pie(uint32_t i) { (void)i; sd1306_draw_pie(64, 32, 30, 90, 330, white_pixel); }
+static void bench_draw_string_time(uint32_t i) { (void)i; sd1306_draw_string(0, 0, (uint8_t*)"12:34", 4, white_pixel); }
+static void bench_draw_string_date(uint32_t i) { (void)i; sd1306_draw_string(0, 32, (uint8_t*)"10/16/2026", 2, white_pixel); }
+static void bench_draw_string_title(uint32_t i) { (void)i; sd1306_draw_string(0, 0, (uint8_t*)"Minute", 3, white_pixel); }
+static void bench_draw_large_digits(uint32_t i) { (void)i; sd1306_draw_large_digits(0, 0, (uint8_t*)"12:34", white_pixel); }
+static void bench_render_time(uint32_t i) { (void)i; sd1306_render_string_columns(bench_columns, OLED_WIDTH, 32, (uint8_t*)"12:34", 4, 1); }
+static void bench_render_date(uint32_t i) { (void)i; sd1306_render_string_columns(bench_columns, OLED_WIDTH, 16, (uint8_t*)"10/16/2026", 2, 0); }
+static void bench_draw_columns(uint32_t i) { (void)i; sd1306_draw_columns(0, 0, bench_columns, OLED_WIDTH, 32, white_pixel); }
+static void bench_draw_img(uint32_t i) { (void)i; sd1306_draw_img(bench_image); }
+static void bench_draw_packed_img(uint32_t i) { (void)i; sd1306_draw_packed_img(0, 0, splash_img, sizeof(splash_img)); }
+static void bench_draw_packed_icon(uint32_t i) { (void)i; sd1306_draw_packed_img(40, 20, splash_img, sizeof(splash_img)); }
+static void bench_clear_oled_buffer(uint32_t i) { (void)i; clear_oled_buffer(); }
+static void bench_fill_oled_buffer(uint32_t i) { (void)i; fill_oled_buffer(); }
+static void bench_kernel_invert(uint32_t i) { (void)i; sd1306_kernel_invert(oled_buffer, BUFFER_SIZE); }
+static void bench_kernel_xor(uint32_t i) { (void)i; sd1306_kernel_xor(oled_buffer, bench_image, BUFFER_SIZE); }
+static void bench_kernel_first_diff(uint32_t i) { (void)i; sd1306_kernel_first_diff(bench_image, bench_image, BUFFER_SIZE); }
+static void bench_kernel_copy_rect(uint32_t i) { (void)i; sd1306_kernel_copy_rect(oled_buffer, bench_image, 0, 3, 32, 95); }
+static void bench_kernel_rect_equal(uint32_t i) { (void)i; sd1306_kernel_rect_equal(bench_image, bench_image, 0, 3, 32, 95); }
+static void bench_set_clip(uint32_t i) { (void)i; sd1306_set_clip(0, 0, OLED_WIDTH, 32); sd1306_reset_clip(); }
+static void bench_clipped_string(uint32_t i)
+{
+	(void)i;
+	sd1306_set_clip(0, 8, OLED_WIDTH, 16);
+	sd1306_draw_string(0, 0, (uint8_t*)"12:34", 4, white_pixel);
+	sd1306_reset_clip();
+}
+static void bench_refresh_unchanged(uint32_t i) { (void)i; sd1306_refresh(); }
+static void bench_refresh_minute(uint32_t i)
+{
+	// The clock face a minute later, only the last digit changes
+	sd1306_draw_large_digits(0, 0, (uint8_t*)((i & 1) ? "12:35" : "12:34"), white_pixel);
+	sd1306_refresh();
+}
+static void bench_refresh_full(uint32_t i) { (void)i; sd1306_invalidate(); sd1306_refresh(); }
+static void bench_invalidate(uint32_t i) { (void)i; sd1306_invalidate(); }
+static void bench_send_command_list(uint32_t i)
+{
+	(void)i;
+	static const uint8_t nop = 0xe3;
+	sd1306_send_command_list(sd1306_ADDR, &nop, 1);
+}
+static void bench_init(uint32_t i) { (void)i; sd1306_init(); }
+static void bench_upside(uint32_t i) { (void)i; upside_down(); upside_up(); }
+static void bench_scroll(uint32_t i) { (void)i; sd1306_start_scroll(scroll_left, 6, 7, scroll_5_frames); sd1306_stop_scroll(); }
+static void bench_diagonal_scroll(uint32_t i) { (void)i; sd1306_start_diagonal_scroll(scroll_left, 6, 7, scroll_5_frames, 1); sd1306_stop_scroll(); }
+static void bench_slide(uint32_t i) { (void)i; sd1306_slide_next_refresh(0); }
+static void bench_get_stats(uint32_t i)
+{
+	(void)i;
+	struct sd1306_stats stats;
+	sd1306_get_stats(&stats);
+}
+static void bench_flush_thread(uint32_t i) { (void)i; sd1306_start_flush_thread(); sd1306_stop_flush_thread(); }
+
+// Every public function of sd1306.h but sd1306_set_backend
+static const struct benchmark_case benchmark_cases[] =
+{
+	{ "sd1306_draw_pixel", "sweep", bench_draw_pixel, BENCHMARK_ITERATIONS, 1 },
+	{ "sd1306_draw_line", "diagonal 128x64", bench_draw_line, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fast_Hline", "length 128", bench_draw_fast_Hline, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fast_Vline", "length 64", bench_draw_fast_Vline, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_rect", "128x64", bench_draw_rect, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fill_rect", "128x16", bench_draw_fill_rect, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_clear_rect", "128x32 time widget", bench_clear_rect, BENCHMARK_ITERATIONS, OLED_WIDTH * 32 },
+	{ "sd1306_draw_round_rect", "128x64 radius 8", bench_draw_round_rect, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fillround_Rect", "128x32 radius 8", bench_draw_fillround_Rect, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_circle_helper", "radius 20 all corners", bench_draw_circle_helper, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fillcircle_helper", "radius 20 both halves", bench_draw_fillcircle_helper, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_circle", "radius 30", bench_draw_circle, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fill_circle", "radius 30", bench_draw_fill_circle, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_triangle", "128x64", bench_draw_triangle, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_fill_triangle", "128x64", bench_draw_fill_triangle, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_arc", "radius 30 90-330", bench_draw_arc, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_pie", "radius 30 90-330", bench_draw_pie, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_string", "time 4x", bench_draw_string_time, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_string", "date 2x", bench_draw_string_date, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_string", "title 3x", bench_draw_string_title, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_string", "time 4x clipped to 16 rows", bench_clipped_string, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_large_digits", "time", bench_draw_large_digits, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_render_string_columns", "time 4x large digits", bench_render_time, BENCHMARK_ITERATIONS, OLED_WIDTH * 32 },
+	{ "sd1306_render_string_columns", "date 2x", bench_render_date, BENCHMARK_ITERATIONS, OLED_WIDTH * 16 },
+	{ "sd1306_draw_columns", "128x32 time widget", bench_draw_columns, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_draw_img", "full screen", bench_draw_img, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_draw_packed_img", "splash", bench_draw_packed_img, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_draw_packed_img", "splash off the page grid", bench_draw_packed_icon, BENCHMARK_ITERATIONS, 0 },
+	{ "clear_oled_buffer", "full screen", bench_clear_oled_buffer, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "fill_oled_buffer", "full screen", bench_fill_oled_buffer, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_kernel_invert", "full screen", bench_kernel_invert, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_kernel_xor", "full screen", bench_kernel_xor, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_kernel_first_diff", "same full screens", bench_kernel_first_diff, BENCHMARK_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_kernel_copy_rect", "64x32 window", bench_kernel_copy_rect, BENCHMARK_ITERATIONS, 64 * 32 },
+	{ "sd1306_kernel_rect_equal", "same 64x32 windows", bench_kernel_rect_equal, BENCHMARK_ITERATIONS, 64 * 32 },
+	{ "sd1306_set_clip", "with sd1306_reset_clip", bench_set_clip, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_refresh", "unchanged", bench_refresh_unchanged, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_refresh", "next minute", bench_refresh_minute, BENCHMARK_BUS_ITERATIONS, 0 },
+	{ "sd1306_refresh", "full frame after sd1306_invalidate", bench_refresh_full, BENCHMARK_BUS_ITERATIONS, OLED_WIDTH * OLED_HEIGHT },
+	{ "sd1306_invalidate", "", bench_invalidate, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_send_command_list", "one nop", bench_send_command_list, BENCHMARK_BUS_ITERATIONS, 0 },
+	{ "sd1306_init", "", bench_init, BENCHMARK_BUS_ITERATIONS, 0 },
+	{ "upside_down", "with upside_up", bench_upside, BENCHMARK_BUS_ITERATIONS, 0 },
+	{ "sd1306_start_scroll", "with sd1306_stop_scroll", bench_scroll, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_start_diagonal_scroll", "with sd1306_stop_scroll", bench_diagonal_scroll, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_slide_next_refresh", "", bench_slide, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_get_stats", "", bench_get_stats, BENCHMARK_ITERATIONS, 0 },
+	{ "sd1306_start_flush_thread", "with sd1306_stop_flush_thread", bench_flush_thread, BENCHMARK_BUS_ITERATIONS, 0 },
+};
+
+/**
+  * @brief  Count the lit pixels of OLED buffer.
+  * @retval Lit pixels.
+  */
+static uint32_t lit_pixels(void)
+{
+	uint32_t count = 0;
+	uint16_t i;
+
+	for (i = 0; i < BUFFER_SIZE; i++)
+	{
+		count += __builtin_popcount(oled_buffer[i]);
+	}
+	return count;
+}
+
+/**
+  * @brief  Time every case and log a CSV line for each, grep for lines starting with Benchmark,
+  * @retval None.
+  */
+static void benchmark_cases_run(void)
+{
+	const struct benchmark_case* bench;
+	struct timespec start;
+	struct timespec end;
+	int64_t ns;
+	uint32_t pixels;
+	uint32_t i;
+	size_t n;
+
+	for (i = 0; i < sizeof(bench_image); i++)
+	{
+		bench_image[i] = (uint8_t)(i * 37);
+	}
+	sd1306_render_string_columns(bench_columns, OLED_WIDTH, 32, (uint8_t*)"12:34", 4, 1);
+
+	Log_Debug("Benchmark,function,parameters,iterations,ns_per_op,pixels_per_s\n");
+	for (n = 0; n < sizeof(benchmark_cases) / sizeof(benchmark_cases[0]); n++)
+	{
+		bench = &benchmark_cases[n];
+
+		pixels = bench->pixels;
+		if (pixels == 0)
+		{
+			clear_oled_buffer();
+			bench->run(0);
+			pixels = lit_pixels();
+		}
+
+		clear_oled_buffer();
+		sd1306_refresh();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench->iterations; i++)
+		{
+			bench->run(i);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ns = elapsed_ns(&start, &end) / bench->iterations;
+
+		Log_Debug("Benchmark,%s,%s,%u,%lld,%lld\n", bench->function, bench->parameters, bench->iterations,
+			(long long)ns, (long long)((int64_t)pixels * 1000000000 / (ns ? ns : 1)));
+	}
+}
+
+/**
+  * @brief  Time the sd1306 drawing routines and log the results.
+  * @note   Draws into OLED buffer and clears it when done. Every public function also gets a line
+  *         "Benchmark,function,parameters,iterations,ns_per_op,pixels_per_s" to track between
+  *         commits, after a "Kernels,path" line naming the kernel path. Stops the flush thread,
+  *         start it again afterwards if it is wanted.
+  * @retval None.
+  */
+void sd1306_benchmark_run(void)
+{
+	// Refreshes are timed writing to the display, not handing over to the flush thread
+	sd1306_stop_flush_thread();
+
+	// Numbers from different kernel paths do not compare
+	Log_Debug("Kernels,%s\n", sd1306_kernel_path());
+	benchmark_draw_string();
+	benchmark_draw_arc();
+	benchmark_cases_run();
+	clear_oled_buffer();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef HEADER_sd1306_benchmark_H
+#define HEADER_sd1306_benchmark_H
+
+/**
+  * @brief  Time the sd1306 drawing routines and log the results.
+  * @note   Draws into OLED buffer and clears it when done. Every public function also gets a line
+  *         "Benchmark,function,parameters,iterations,ns_per_op,pixels_per_s" to track between
+  *         commits. Stops the flush thread, start it again afterwards if it is wanted.
+  * @retval None.
+  */
+extern void sd1306_benchmark_run(void);
+
+#endif
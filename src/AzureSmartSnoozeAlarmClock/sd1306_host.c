@@ -0,0 +1,210 @@
+/***************************************************************************************************
+   Name: sd1306_host.c
+   Sphere OS: 19.05
+****************************************************************************************************/
+
+#include <stdio.h>
+#include "sd1306_host.h"
+
+/**
+  * @brief  Number of argument bytes following a command
+  * @param  cmd: command
+  * @retval Argument bytes.
+  */
+static uint8_t sd1306_host_arguments(uint8_t cmd)
+{
+	switch (cmd)
+	{
+	case 0x20: case 0x81: case 0x8d: case 0xa8: case 0xd3: case 0xd5: case 0xd9: case 0xda: case 0xdb:
+		return 1;
+	case 0x21: case 0x22: case 0xa3:
+		return 2;
+	case 0x29: case 0x2a:
+		return 5;
+	case 0x26: case 0x27:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+/**
+  * @brief  Apply a command stream to the sink, only addressing and start line matter to the picture
+  * @param  sink: sink to update
+  * @param  cmds: commands and their arguments
+  * @param  length: number of bytes in cmds
+  * @retval None.
+  */
+static void sd1306_host_commands(struct sd1306_host_sink* sink, const uint8_t* cmds, uint16_t length)
+{
+	uint16_t i = 0;
+	uint8_t cmd;
+
+	while (i < length)
+	{
+		cmd = cmds[i];
+		if (i + sd1306_host_arguments(cmd) >= length)
+		{
+			// Arguments cut off, the controller would wait for the next transfer
+			return;
+		}
+
+		if (cmd == 0x21)
+		{
+			sink->first_col = cmds[i + 1] & (OLED_WIDTH - 1);
+			sink->last_col = cmds[i + 2] & (OLED_WIDTH - 1);
+			sink->col = sink->first_col;
+		}
+		else if (cmd == 0x22)
+		{
+			sink->first_page = cmds[i + 1] & (OLED_PAGES - 1);
+			sink->last_page = cmds[i + 2] & (OLED_PAGES - 1);
+			sink->page = sink->first_page;
+		}
+		else if (cmd >= 0x40 && cmd <= 0x7f)
+		{
+			sink->start_line = cmd & (OLED_HEIGHT - 1);
+		}
+		i += 1 + sd1306_host_arguments(cmd);
+	}
+}
+
+/**
+  * @brief  Write data to the sink's OLED RAM window, horizontal addressing mode
+  * @param  sink: sink to update
+  * @param  data: data bytes
+  * @param  length: number of bytes in data
+  * @retval None.
+  */
+static void sd1306_host_data(struct sd1306_host_sink* sink, const uint8_t* data, uint16_t length)
+{
+	uint16_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		sink->ram[sink->col + sink->page * OLED_WIDTH] = data[i];
+		if (sink->col != sink->last_col)
+		{
+			sink->col = (sink->col + 1) & (OLED_WIDTH - 1);
+			continue;
+		}
+		sink->col = sink->first_col;
+		sink->page = sink->page == sink->last_page ? sink->first_page : (sink->page + 1) & (OLED_PAGES - 1);
+	}
+	sink->data_bytes += length;
+}
+
+/**
+  * @brief  Backend write, decodes a transfer into the sink
+  * @param  context: sink
+  * @param  addr: address of device, ignored
+  * @param  bytes: control byte and payload
+  * @param  length: number of bytes in bytes
+  * @retval Bytes taken, negative if the transfer is empty.
+  */
+static int32_t sd1306_host_write(void* context, uint8_t addr, const uint8_t* bytes, uint16_t length)
+{
+	struct sd1306_host_sink* sink = context;
+
+	(void)addr;
+	if (length == 0)
+	{
+		return -1;
+	}
+
+	sink->transfers++;
+	sink->bytes += length;
+	if (bytes[0] == 0x40)
+	{
+		sd1306_host_data(sink, &bytes[1], length - 1);
+	}
+	else
+	{
+		sd1306_host_commands(sink, &bytes[1], length - 1);
+	}
+	return length;
+}
+
+/**
+  * @brief  Backend frame_done, counts the frame and dumps it
+  * @param  context: sink
+  * @retval None.
+  */
+static void sd1306_host_frame_done(void* context)
+{
+	struct sd1306_host_sink* sink = context;
+	char path[256];
+
+	if (sink->directory != NULL)
+	{
+		snprintf(path, sizeof(path), "%s/frame_%05u.pbm", sink->directory, sink->frames);
+		if (sd1306_host_dump_pbm(sink, path) != 0)
+		{
+			sink->dump_errors++;
+		}
+	}
+	sink->frames++;
+}
+
+/**
+  * @brief  Set up a backend that sends transfers to a host sink
+  * @param  backend: backend to set up
+  * @param  sink: sink to clear and decode transfers into
+  * @param  directory: where frames are dumped, NULL to not dump them
+  * @retval None.
+  */
+void sd1306_host_backend_init(struct sd1306_backend* backend, struct sd1306_host_sink* sink, const char* directory)
+{
+	memset(sink, 0, sizeof(*sink));
+	sink->directory = directory;
+	sink->last_col = OLED_WIDTH - 1;
+	sink->last_page = OLED_PAGES - 1;
+
+	backend->write = sd1306_host_write;
+	backend->frame_done = sd1306_host_frame_done;
+	backend->context = sink;
+}
+
+/**
+  * @brief  Write what the display shows to a PBM file
+  * @param  sink: sink to dump
+  * @param  path: file to write
+  * @retval Zero if was succefully, negative if was unsuccefully.
+  * @note   Lit pixels are white, so the picture looks like the display.
+  */
+int32_t sd1306_host_dump_pbm(const struct sd1306_host_sink* sink, const char* path)
+{
+	uint8_t row[OLED_WIDTH / 8];
+	int32_t x;
+	int32_t y;
+	int32_t ram_y;
+	FILE* file = fopen(path, "wb");
+
+	if (file == NULL)
+	{
+		return -1;
+	}
+
+	fprintf(file, "P4\n%d %d\n", OLED_WIDTH, OLED_HEIGHT);
+	for (y = 0; y < OLED_HEIGHT; y++)
+	{
+		// The start line decides which RAM row is shown on top
+		ram_y = (y + sink->start_line) & (OLED_HEIGHT - 1);
+		memset(row, 0, sizeof(row));
+		for (x = 0; x < OLED_WIDTH; x++)
+		{
+			// PBM bits are black, set them for the pixels that are off
+			if (!(sink->ram[x + (ram_y / 8) * OLED_WIDTH] & (1 << (ram_y & 7))))
+			{
+				row[x / 8] |= 0x80 >> (x & 7);
+			}
+		}
+		fwrite(row, 1, sizeof(row), file);
+	}
+
+	if (fclose(file) != 0)
+	{
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef HEADER_sd1306_host_H
+#define HEADER_sd1306_host_H
+
+#include "sd1306.h"
+
+// Stands in for the panel off the device. Transfers are decoded into a copy of OLED RAM and every
+// frame written by a refresh can be dumped to a PBM file, so rendering can be profiled on a PC.
+struct sd1306_host_sink
+{
+	// Directory frames are dumped to as frame_00000.pbm and on, NULL to only count
+	const char* directory;
+	// Frames written by refreshes
+	uint32_t frames;
+	// Transfers, and their bytes with control bytes and commands
+	uint32_t transfers;
+	uint64_t bytes;
+	// Bytes written to OLED RAM
+	uint64_t data_bytes;
+	// Frames that could not be dumped
+	uint32_t dump_errors;
+	// OLED RAM and the window data goes to, as set by 0x21 and 0x22
+	uint8_t ram[BUFFER_SIZE];
+	uint8_t first_col;
+	uint8_t last_col;
+	uint8_t first_page;
+	uint8_t last_page;
+	uint8_t col;
+	uint8_t page;
+	// Row of OLED RAM shown at the top of the display
+	uint8_t start_line;
+};
+
+/**
+  * @brief  Set up a backend that sends transfers to a host sink
+  * @param  backend: backend to set up
+  * @param  sink: sink to clear and decode transfers into
+  * @param  directory: where frames are dumped, NULL to not dump them
+  * @retval None.
+  */
+extern void sd1306_host_backend_init(struct sd1306_backend* backend, struct sd1306_host_sink* sink, const char* directory);
+
+/**
+  * @brief  Write what the display shows to a PBM file
+  * @param  sink: sink to dump
+  * @param  path: file to write
+  * @retval Zero if was succefully, negative if was unsuccefully.
+  * @note   Lit pixels are white, so the picture looks like the display.
+  */
+extern int32_t sd1306_host_dump_pbm(const struct sd1306_host_sink* sink, const char* path);
+
+#endif
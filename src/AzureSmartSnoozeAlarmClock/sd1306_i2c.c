@@ -0,0 +1,29 @@
+/***************************************************************************************************
+   Name: sd1306_i2c.c
+   Sphere OS: 19.05
+****************************************************************************************************/
+
+#include <applibs/i2c.h>
+#include "i2c.h"
+#include "sd1306.h"
+
+/**
+  * @brief  Write a transfer to the panel on the I2C bus
+  * @param  context: unused
+  * @param  addr: address of device
+  * @param  bytes: control byte and payload
+  * @param  length: number of bytes in bytes
+  * @retval retval: negative if was unsuccefully, positive if was succefully
+  */
+static int32_t sd1306_i2c_write(void* context, uint8_t addr, const uint8_t* bytes, uint16_t length)
+{
+	(void)context;
+	return I2CMaster_Write(i2cFd, addr, bytes, length);
+}
+
+const struct sd1306_backend sd1306_i2c_backend =
+{
+	.write = sd1306_i2c_write,
+	.frame_done = NULL,
+	.context = NULL,
+};
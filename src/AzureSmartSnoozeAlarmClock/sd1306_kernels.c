@@ -0,0 +1,597 @@
+/***************************************************************************************************
+   Name: sd1306_kernels.c
+   Sphere OS: 19.05
+****************************************************************************************************/
+
+#include "sd1306.h"
+#include "sd1306_kernels.h"
+
+#if defined(SD1306_KERNEL_NEON)
+#include <arm_neon.h>
+#elif defined(SD1306_KERNEL_SSE2)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Byte path, the tail of the wider paths
+ */
+
+static void fill_byte(uint8_t* dst, uint8_t value, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		dst[i] = value;
+	}
+}
+
+static void invert_byte(uint8_t* dst, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		dst[i] = ~dst[i];
+	}
+}
+
+static void copy_byte(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		dst[i] = src[i];
+	}
+}
+
+static void xor_byte(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		dst[i] ^= src[i];
+	}
+}
+
+static uint32_t first_diff_byte(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	uint32_t i = 0;
+
+	while (i < length && a[i] == b[i])
+	{
+		i++;
+	}
+	return i;
+}
+
+static uint32_t last_diff_byte(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	while (length > 0 && a[length - 1] == b[length - 1])
+	{
+		length--;
+	}
+	return length;
+}
+
+/*
+ * Word path, 32 bits at a time with memcpy so any alignment works
+ */
+
+static void fill_word(uint8_t* dst, uint8_t value, uint32_t length)
+{
+	uint32_t word = value * 0x01010101u;
+	uint32_t i = 0;
+
+	for (; i + 4 <= length; i += 4)
+	{
+		memcpy(&dst[i], &word, sizeof(word));
+	}
+	fill_byte(&dst[i], value, length - i);
+}
+
+static void invert_word(uint8_t* dst, uint32_t length)
+{
+	uint32_t word;
+	uint32_t i = 0;
+
+	for (; i + 4 <= length; i += 4)
+	{
+		memcpy(&word, &dst[i], sizeof(word));
+		word = ~word;
+		memcpy(&dst[i], &word, sizeof(word));
+	}
+	invert_byte(&dst[i], length - i);
+}
+
+static void copy_word(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t word;
+	uint32_t i = 0;
+
+	for (; i + 4 <= length; i += 4)
+	{
+		memcpy(&word, &src[i], sizeof(word));
+		memcpy(&dst[i], &word, sizeof(word));
+	}
+	copy_byte(&dst[i], &src[i], length - i);
+}
+
+static void xor_word(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t word;
+	uint32_t src_word;
+	uint32_t i = 0;
+
+	for (; i + 4 <= length; i += 4)
+	{
+		memcpy(&word, &dst[i], sizeof(word));
+		memcpy(&src_word, &src[i], sizeof(src_word));
+		word ^= src_word;
+		memcpy(&dst[i], &word, sizeof(word));
+	}
+	xor_byte(&dst[i], &src[i], length - i);
+}
+
+static uint32_t first_diff_word(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	uint32_t word_a;
+	uint32_t word_b;
+	uint32_t i = 0;
+
+	for (; i + 4 <= length; i += 4)
+	{
+		memcpy(&word_a, &a[i], sizeof(word_a));
+		memcpy(&word_b, &b[i], sizeof(word_b));
+		if (word_a != word_b)
+		{
+			break;
+		}
+	}
+	return i + first_diff_byte(&a[i], &b[i], length - i);
+}
+
+static uint32_t last_diff_word(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	uint32_t word_a;
+	uint32_t word_b;
+
+	for (; length >= 4; length -= 4)
+	{
+		memcpy(&word_a, &a[length - 4], sizeof(word_a));
+		memcpy(&word_b, &b[length - 4], sizeof(word_b));
+		if (word_a != word_b)
+		{
+			break;
+		}
+	}
+	return last_diff_byte(a, b, length);
+}
+
+#if defined(SD1306_KERNEL_NEON)
+/*
+ * NEON vectors, unaligned loads and stores are fine on the Cortex-A7
+ */
+
+typedef uint8x16_t vector;
+
+static inline vector vector_load(const uint8_t* src) { return vld1q_u8(src); }
+static inline void vector_store(uint8_t* dst, vector v) { vst1q_u8(dst, v); }
+static inline vector vector_dup(uint8_t value) { return vdupq_n_u8(value); }
+static inline vector vector_not(vector v) { return vmvnq_u8(v); }
+static inline vector vector_xor(vector a, vector b) { return veorq_u8(a, b); }
+static inline vector vector_or(vector a, vector b) { return vorrq_u8(a, b); }
+static inline uint8_t vector_any(vector v)
+{
+	uint64x2_t words = vreinterpretq_u64_u8(v);
+
+	return (vgetq_lane_u64(words, 0) | vgetq_lane_u64(words, 1)) != 0;
+}
+
+#define SD1306_KERNEL_SIMD_NAME "neon"
+
+#elif defined(SD1306_KERNEL_SSE2)
+/*
+ * SSE2 vectors, with unaligned loads and stores
+ */
+
+typedef __m128i vector;
+
+static inline vector vector_load(const uint8_t* src) { return _mm_loadu_si128((const __m128i*)src); }
+static inline void vector_store(uint8_t* dst, vector v) { _mm_storeu_si128((__m128i*)dst, v); }
+static inline vector vector_dup(uint8_t value) { return _mm_set1_epi8((char)value); }
+static inline vector vector_not(vector v) { return _mm_xor_si128(v, _mm_set1_epi8((char)0xff)); }
+static inline vector vector_xor(vector a, vector b) { return _mm_xor_si128(a, b); }
+static inline vector vector_or(vector a, vector b) { return _mm_or_si128(a, b); }
+static inline uint8_t vector_any(vector v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xffff; }
+
+#define SD1306_KERNEL_SIMD_NAME "sse2"
+
+#endif
+
+#ifdef SD1306_KERNEL_SIMD_NAME
+/*
+ * Vector path, four vectors a step while a whole 64 bytes is left, then one, then the word path
+ */
+
+#define VECTOR 16
+#define BLOCK (4 * VECTOR)
+
+static void fill_simd(uint8_t* dst, uint8_t value, uint32_t length)
+{
+	vector v = vector_dup(value);
+	uint32_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK)
+	{
+		vector_store(&dst[i], v);
+		vector_store(&dst[i + VECTOR], v);
+		vector_store(&dst[i + 2 * VECTOR], v);
+		vector_store(&dst[i + 3 * VECTOR], v);
+	}
+	for (; i + VECTOR <= length; i += VECTOR)
+	{
+		vector_store(&dst[i], v);
+	}
+	fill_word(&dst[i], value, length - i);
+}
+
+static void invert_simd(uint8_t* dst, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK)
+	{
+		vector_store(&dst[i], vector_not(vector_load(&dst[i])));
+		vector_store(&dst[i + VECTOR], vector_not(vector_load(&dst[i + VECTOR])));
+		vector_store(&dst[i + 2 * VECTOR], vector_not(vector_load(&dst[i + 2 * VECTOR])));
+		vector_store(&dst[i + 3 * VECTOR], vector_not(vector_load(&dst[i + 3 * VECTOR])));
+	}
+	for (; i + VECTOR <= length; i += VECTOR)
+	{
+		vector_store(&dst[i], vector_not(vector_load(&dst[i])));
+	}
+	invert_word(&dst[i], length - i);
+}
+
+static void copy_simd(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK)
+	{
+		vector_store(&dst[i], vector_load(&src[i]));
+		vector_store(&dst[i + VECTOR], vector_load(&src[i + VECTOR]));
+		vector_store(&dst[i + 2 * VECTOR], vector_load(&src[i + 2 * VECTOR]));
+		vector_store(&dst[i + 3 * VECTOR], vector_load(&src[i + 3 * VECTOR]));
+	}
+	for (; i + VECTOR <= length; i += VECTOR)
+	{
+		vector_store(&dst[i], vector_load(&src[i]));
+	}
+	copy_word(&dst[i], &src[i], length - i);
+}
+
+/**
+  * @brief  XOR one vector of src into dst
+  * @param  dst: bytes to XOR into
+  * @param  src: bytes to XOR with
+  * @retval None.
+  */
+static inline void xor_vector(uint8_t* dst, const uint8_t* src)
+{
+	vector_store(dst, vector_xor(vector_load(dst), vector_load(src)));
+}
+
+static void xor_simd(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK)
+	{
+		xor_vector(&dst[i], &src[i]);
+		xor_vector(&dst[i + VECTOR], &src[i + VECTOR]);
+		xor_vector(&dst[i + 2 * VECTOR], &src[i + 2 * VECTOR]);
+		xor_vector(&dst[i + 3 * VECTOR], &src[i + 3 * VECTOR]);
+	}
+	for (; i + VECTOR <= length; i += VECTOR)
+	{
+		xor_vector(&dst[i], &src[i]);
+	}
+	xor_word(&dst[i], &src[i], length - i);
+}
+
+/**
+  * @brief  Check a block of two runs for a difference
+  * @param  a: first run
+  * @param  b: second run
+  * @retval Nonzero if any of the BLOCK bytes differs.
+  */
+static inline uint8_t block_differs(const uint8_t* a, const uint8_t* b)
+{
+	vector d0 = vector_xor(vector_load(a), vector_load(b));
+	vector d1 = vector_xor(vector_load(&a[VECTOR]), vector_load(&b[VECTOR]));
+	vector d2 = vector_xor(vector_load(&a[2 * VECTOR]), vector_load(&b[2 * VECTOR]));
+	vector d3 = vector_xor(vector_load(&a[3 * VECTOR]), vector_load(&b[3 * VECTOR]));
+
+	return vector_any(vector_or(vector_or(d0, d1), vector_or(d2, d3)));
+}
+
+// The smaller steps find where in the block or vector the difference is
+static uint32_t first_diff_simd(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	uint32_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK)
+	{
+		if (block_differs(&a[i], &b[i]))
+		{
+			break;
+		}
+	}
+	for (; i + VECTOR <= length; i += VECTOR)
+	{
+		if (vector_any(vector_xor(vector_load(&a[i]), vector_load(&b[i]))))
+		{
+			break;
+		}
+	}
+	return i + first_diff_word(&a[i], &b[i], length - i);
+}
+
+static uint32_t last_diff_simd(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	for (; length >= BLOCK; length -= BLOCK)
+	{
+		if (block_differs(&a[length - BLOCK], &b[length - BLOCK]))
+		{
+			break;
+		}
+	}
+	for (; length >= VECTOR; length -= VECTOR)
+	{
+		if (vector_any(vector_xor(vector_load(&a[length - VECTOR]), vector_load(&b[length - VECTOR]))))
+		{
+			break;
+		}
+	}
+	return last_diff_word(a, b, length);
+}
+
+#endif
+
+// The public kernels call the widest path directly
+#ifdef SD1306_KERNEL_SIMD_NAME
+#define KERNEL(name) name##_simd
+#else
+#define KERNEL(name) name##_word
+#endif
+
+/**
+  * @brief  Set a run of bytes to a value
+  * @param  dst: bytes to set
+  * @param  value: value to set
+  * @param  length: number of bytes
+  * @retval None.
+  */
+void sd1306_kernel_fill(uint8_t* dst, uint8_t value, uint32_t length)
+{
+	KERNEL(fill)(dst, value, length);
+}
+
+/**
+  * @brief  Invert every bit of a run of bytes
+  * @param  dst: bytes to invert
+  * @param  length: number of bytes
+  * @retval None.
+  */
+void sd1306_kernel_invert(uint8_t* dst, uint32_t length)
+{
+	KERNEL(invert)(dst, length);
+}
+
+/**
+  * @brief  Copy a run of bytes, the runs must not overlap
+  * @param  dst: where to copy to
+  * @param  src: where to copy from
+  * @param  length: number of bytes
+  * @retval None.
+  */
+void sd1306_kernel_copy(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	KERNEL(copy)(dst, src, length);
+}
+
+/**
+  * @brief  XOR a run of bytes into another, the runs must not overlap
+  * @param  dst: bytes to XOR into
+  * @param  src: bytes to XOR with
+  * @param  length: number of bytes
+  * @retval None.
+  */
+void sd1306_kernel_xor(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	KERNEL(xor)(dst, src, length);
+}
+
+/**
+  * @brief  Find the first byte where two runs differ
+  * @param  a: first run
+  * @param  b: second run
+  * @param  length: number of bytes
+  * @retval Index of the first difference, length if the runs are the same.
+  */
+uint32_t sd1306_kernel_first_diff(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	return KERNEL(first_diff)(a, b, length);
+}
+
+/**
+  * @brief  Find the last byte where two runs differ
+  * @param  a: first run
+  * @param  b: second run
+  * @param  length: number of bytes
+  * @retval Index one past the last difference, zero if the runs are the same.
+  */
+uint32_t sd1306_kernel_last_diff(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	return KERNEL(last_diff)(a, b, length);
+}
+
+/**
+  * @brief  Set a window of an OLED buffer to a value
+  * @param  buffer: OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @param  value: value to set
+  * @retval None.
+  * @note   Full width windows are contiguous and go as one run, as do the rect kernels below.
+  */
+void sd1306_kernel_fill_rect(uint8_t* buffer, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col, uint8_t value)
+{
+	uint32_t width = last_col - first_col + 1;
+	uint8_t page;
+
+	if (width == OLED_WIDTH)
+	{
+		KERNEL(fill)(&buffer[first_page * OLED_WIDTH], value, (last_page - first_page + 1) * OLED_WIDTH);
+		return;
+	}
+	for (page = first_page; page <= last_page; page++)
+	{
+		KERNEL(fill)(&buffer[first_col + page * OLED_WIDTH], value, width);
+	}
+}
+
+/**
+  * @brief  Invert a window of an OLED buffer
+  * @param  buffer: OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+void sd1306_kernel_invert_rect(uint8_t* buffer, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col)
+{
+	uint32_t width = last_col - first_col + 1;
+	uint8_t page;
+
+	if (width == OLED_WIDTH)
+	{
+		KERNEL(invert)(&buffer[first_page * OLED_WIDTH], (last_page - first_page + 1) * OLED_WIDTH);
+		return;
+	}
+	for (page = first_page; page <= last_page; page++)
+	{
+		KERNEL(invert)(&buffer[first_col + page * OLED_WIDTH], width);
+	}
+}
+
+/**
+  * @brief  Copy a window of an OLED buffer to the same window of another
+  * @param  dst: OLED buffer to copy to
+  * @param  src: OLED buffer to copy from
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+void sd1306_kernel_copy_rect(uint8_t* dst, const uint8_t* src, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col)
+{
+	uint32_t width = last_col - first_col + 1;
+	uint32_t offset;
+	uint8_t page;
+
+	if (width == OLED_WIDTH)
+	{
+		offset = first_page * OLED_WIDTH;
+		KERNEL(copy)(&dst[offset], &src[offset], (last_page - first_page + 1) * OLED_WIDTH);
+		return;
+	}
+	for (page = first_page; page <= last_page; page++)
+	{
+		offset = first_col + page * OLED_WIDTH;
+		KERNEL(copy)(&dst[offset], &src[offset], width);
+	}
+}
+
+/**
+  * @brief  XOR a window of an OLED buffer into the same window of another
+  * @param  dst: OLED buffer to XOR into
+  * @param  src: OLED buffer to XOR with
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+void sd1306_kernel_xor_rect(uint8_t* dst, const uint8_t* src, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col)
+{
+	uint32_t width = last_col - first_col + 1;
+	uint32_t offset;
+	uint8_t page;
+
+	if (width == OLED_WIDTH)
+	{
+		offset = first_page * OLED_WIDTH;
+		KERNEL(xor)(&dst[offset], &src[offset], (last_page - first_page + 1) * OLED_WIDTH);
+		return;
+	}
+	for (page = first_page; page <= last_page; page++)
+	{
+		offset = first_col + page * OLED_WIDTH;
+		KERNEL(xor)(&dst[offset], &src[offset], width);
+	}
+}
+
+/**
+  * @brief  Compare the same window of two OLED buffers
+  * @param  a: first OLED buffer
+  * @param  b: second OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval Nonzero if the windows are the same.
+  */
+uint8_t sd1306_kernel_rect_equal(const uint8_t* a, const uint8_t* b, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col)
+{
+	uint32_t width = last_col - first_col + 1;
+	uint32_t offset;
+	uint8_t page;
+
+	if (width == OLED_WIDTH)
+	{
+		offset = first_page * OLED_WIDTH;
+		width = (last_page - first_page + 1) * OLED_WIDTH;
+		return KERNEL(first_diff)(&a[offset], &b[offset], width) == width;
+	}
+	for (page = first_page; page <= last_page; page++)
+	{
+		offset = first_col + page * OLED_WIDTH;
+		if (KERNEL(first_diff)(&a[offset], &b[offset], width) != width)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+  * @brief  Name of the path the kernels use
+  * @retval "neon", "sse2" or "word".
+  */
+const char* sd1306_kernel_path(void)
+{
+#ifdef SD1306_KERNEL_SIMD_NAME
+	return SD1306_KERNEL_SIMD_NAME;
+#else
+	return "word";
+#endif
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef HEADER_sd1306_kernels_H
+#define HEADER_sd1306_kernels_H
+
+#include <stdint.h>
+
+// Byte kernels over OLED buffers and the windows of them. The widest path the compiler targets is
+// used, NEON on the Cortex-A7, SSE2 on x86 hosts and 32 bit words elsewhere. Define
+// SD1306_KERNEL_PORTABLE to use the word path everywhere, or SD1306_KERNEL_NEON or
+// SD1306_KERNEL_SSE2 to pick a path.
+#if !defined(SD1306_KERNEL_PORTABLE) && !defined(SD1306_KERNEL_NEON) && !defined(SD1306_KERNEL_SSE2)
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SD1306_KERNEL_NEON
+#elif defined(__SSE2__)
+#define SD1306_KERNEL_SSE2
+#endif
+#endif
+
+/**
+  * @brief  Set a run of bytes to a value
+  * @param  dst: bytes to set
+  * @param  value: value to set
+  * @param  length: number of bytes
+  * @retval None.
+  */
+extern void sd1306_kernel_fill(uint8_t* dst, uint8_t value, uint32_t length);
+
+/**
+  * @brief  Invert every bit of a run of bytes
+  * @param  dst: bytes to invert
+  * @param  length: number of bytes
+  * @retval None.
+  */
+extern void sd1306_kernel_invert(uint8_t* dst, uint32_t length);
+
+/**
+  * @brief  Copy a run of bytes, the runs must not overlap
+  * @param  dst: where to copy to
+  * @param  src: where to copy from
+  * @param  length: number of bytes
+  * @retval None.
+  */
+extern void sd1306_kernel_copy(uint8_t* dst, const uint8_t* src, uint32_t length);
+
+/**
+  * @brief  XOR a run of bytes into another, the runs must not overlap
+  * @param  dst: bytes to XOR into
+  * @param  src: bytes to XOR with
+  * @param  length: number of bytes
+  * @retval None.
+  */
+extern void sd1306_kernel_xor(uint8_t* dst, const uint8_t* src, uint32_t length);
+
+/**
+  * @brief  Find the first byte where two runs differ
+  * @param  a: first run
+  * @param  b: second run
+  * @param  length: number of bytes
+  * @retval Index of the first difference, length if the runs are the same.
+  */
+extern uint32_t sd1306_kernel_first_diff(const uint8_t* a, const uint8_t* b, uint32_t length);
+
+/**
+  * @brief  Find the last byte where two runs differ
+  * @param  a: first run
+  * @param  b: second run
+  * @param  length: number of bytes
+  * @retval Index one past the last difference, zero if the runs are the same.
+  */
+extern uint32_t sd1306_kernel_last_diff(const uint8_t* a, const uint8_t* b, uint32_t length);
+
+/**
+  * @brief  Set a window of an OLED buffer to a value
+  * @param  buffer: OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @param  value: value to set
+  * @retval None.
+  */
+extern void sd1306_kernel_fill_rect(uint8_t* buffer, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col, uint8_t value);
+
+/**
+  * @brief  Invert a window of an OLED buffer
+  * @param  buffer: OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+extern void sd1306_kernel_invert_rect(uint8_t* buffer, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col);
+
+/**
+  * @brief  Copy a window of an OLED buffer to the same window of another
+  * @param  dst: OLED buffer to copy to
+  * @param  src: OLED buffer to copy from
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+extern void sd1306_kernel_copy_rect(uint8_t* dst, const uint8_t* src, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col);
+
+/**
+  * @brief  XOR a window of an OLED buffer into the same window of another
+  * @param  dst: OLED buffer to XOR into
+  * @param  src: OLED buffer to XOR with
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval None.
+  */
+extern void sd1306_kernel_xor_rect(uint8_t* dst, const uint8_t* src, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col);
+
+/**
+  * @brief  Compare the same window of two OLED buffers
+  * @param  a: first OLED buffer
+  * @param  b: second OLED buffer
+  * @param  first_page: first page of the window
+  * @param  last_page: last page of the window
+  * @param  first_col: first column of the window
+  * @param  last_col: last column of the window
+  * @retval Nonzero if the windows are the same.
+  */
+extern uint8_t sd1306_kernel_rect_equal(const uint8_t* a, const uint8_t* b, uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col);
+
+/**
+  * @brief  Name of the path the kernels use
+  * @retval "neon", "sse2" or "word".
+  */
+extern const char* sd1306_kernel_path(void);
+
+#endif
@@ -0,0 +1,373 @@
+/***************************************************************************************************
+   Name: sd1306_rop.h
+   Raster operation template of the sd1306 primitives, no include guard on purpose.
+
+   sd1306.c includes it once per pixel color with SD1306_ROP_NAME set to the suffix of the
+   generated functions (set, clear, xor) and SD1306_ROP(dst, bits) set to the byte operation, so
+   the color is decided once per primitive instead of once per pixel. The generated functions
+   only draw inside the clip rectangle and leave marking the dirty windows to the caller.
+****************************************************************************************************/
+
+#ifndef SD1306_ROP_FN
+#define SD1306_ROP_PASTE(name, suffix) name##_##suffix
+#define SD1306_ROP_EXPAND(name, suffix) SD1306_ROP_PASTE(name, suffix)
+#define SD1306_ROP_FN(name) SD1306_ROP_EXPAND(name, SD1306_ROP_NAME)
+#endif
+
+/**
+  * @brief  Draw a pixel
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  clipped: test the pixel against the clip rectangle, zero when the caller knows it is inside
+  * @retval None.
+  */
+static inline void SD1306_ROP_FN(sd1306_plot)(int32_t x, int32_t y, const uint8_t clipped)
+{
+	if (!clipped || sd1306_clip_contains(x, y))
+	{
+		SD1306_ROP(oled_buffer[x + (y / 8) * OLED_WIDTH], 1 << (y & 7));
+	}
+}
+
+/**
+  * @brief  Draw the same rows of a run of columns of one page
+  * @param  row: page of OLED buffer
+  * @param  x0: first column
+  * @param  x1: last column
+  * @param  mask: rows to draw
+  * @retval None.
+  */
+static void SD1306_ROP_FN(sd1306_span)(uint8_t* row, int32_t x0, int32_t x1, uint8_t mask)
+{
+	for (; x0 <= x1; x0++)
+	{
+		SD1306_ROP(row[x0], mask);
+	}
+}
+
+/**
+  * @brief  Draw a column of up to 64 pixels with whole byte writes
+  * @param  x: x coordinate of the column
+  * @param  y: y coordinate of bit 0 of the column, must not be negative
+  * @param  column: pixels to draw, bit 0 is the top one
+  * @retval None.
+  */
+static void SD1306_ROP_FN(sd1306_column)(int32_t x, int32_t y, uint64_t column)
+{
+	uint8_t* dst;
+	int32_t page;
+	int32_t shift;
+
+	if (x < display->clip_x0 || x > display->clip_x1 || y >= OLED_HEIGHT)
+	{
+		return;
+	}
+
+	page = y / 8;
+	shift = y & 7;
+	dst = &oled_buffer[x + page * OLED_WIDTH];
+
+	if (shift != 0)
+	{
+		// Column straddles pages, first page only takes the rows below y
+		SD1306_ROP(*dst, (uint8_t)(column << shift) & display->clip_page_mask[page]);
+		column >>= 8 - shift;
+		page++;
+		dst += OLED_WIDTH;
+	}
+
+	// Column is page aligned now, every page takes the next 8 rows
+	for (; column != 0 && page < OLED_PAGES; page++, dst += OLED_WIDTH)
+	{
+		SD1306_ROP(*dst, (uint8_t)column & display->clip_page_mask[page]);
+		column >>= 8;
+	}
+}
+
+/**
+  * @brief  Draw a page native glyph, page rows of column bytes with bit 0 the top row of the page
+  * @param  x: x coordinate of the glyph
+  * @param  y: y coordinate of the glyph
+  * @param  glyph: pages rows of width bytes
+  * @param  width: glyph width
+  * @param  height: glyph height, at most 64
+  * @retval None.
+  */
+static void SD1306_ROP_FN(sd1306_glyph)(int32_t x, int32_t y, const uint8_t* glyph, int32_t width, int32_t height)
+{
+	int32_t pages = (height + 7) / 8;
+	int32_t first = x < display->clip_x0 ? display->clip_x0 - x : 0;
+	int32_t last = x + width > display->clip_x1 + 1 ? display->clip_x1 + 1 - x : width;
+	int32_t page;
+	int32_t i;
+	uint64_t column;
+	uint8_t mask;
+	uint8_t* dst;
+	const uint8_t* src;
+
+	if (y >= 0 && (y & 7) == 0)
+	{
+		// Page aligned, glyph page rows go straight into OLED pages
+		for (page = 0; page < pages && y / 8 + page < OLED_PAGES; page++)
+		{
+			mask = display->clip_page_mask[y / 8 + page];
+			dst = &oled_buffer[x + (y / 8 + page) * OLED_WIDTH];
+			src = &glyph[page * width];
+			for (i = first; i < last; i++)
+			{
+				SD1306_ROP(dst[i], src[i] & mask);
+			}
+		}
+		return;
+	}
+
+	// Glyph straddles pages, gather each column and shift it into place
+	for (i = first; i < last; i++)
+	{
+		column = 0;
+		for (page = 0; page < pages; page++)
+		{
+			column |= (uint64_t)glyph[page * width + i] << (page * 8);
+		}
+		if (y < 0)
+		{
+			column = y > -64 ? column >> -y : 0;
+		}
+		if (column != 0)
+		{
+			SD1306_ROP_FN(sd1306_column)(x + i, y < 0 ? 0 : y, column);
+		}
+	}
+}
+
+/**
+  * @brief  Draw a line
+  * @param  x1: x coordinate of start point
+  * @param  y1: y coordinate of start point
+  * @param  x2: x coordinate of end point
+  * @param  y2: y coordinate of end point
+  * @param  clipped: test every pixel against the clip rectangle
+  * @retval None.
+  */
+static inline void SD1306_ROP_FN(sd1306_line)(int32_t x1, int32_t y1, int32_t x2, int32_t y2, const uint8_t clipped)
+{
+	int32_t x;
+	int32_t y;
+	int32_t addx;
+	int32_t addy;
+	int32_t dx;
+	int32_t dy;
+	int32_t P;
+	int32_t i;
+
+	dx = abs(x2 - x1);
+	dy = abs(y2 - y1);
+	x = x1;
+	y = y1;
+	addx = x1 > x2 ? -1 : 1;
+	addy = y1 > y2 ? -1 : 1;
+
+	if (dx >= dy)
+	{
+		P = 2 * dy - dx;
+
+		for (i = 0; i <= dx; ++i)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x, y, clipped);
+
+			if (P < 0)
+			{
+				P += 2 * dy;
+				x += addx;
+			}
+			else
+			{
+				P += 2 * dy - 2 * dx;
+				x += addx;
+				y += addy;
+			}
+		}
+	}
+	else
+	{
+		P = 2 * dx - dy;
+
+		for (i = 0; i <= dy; ++i)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x, y, clipped);
+
+			if (P < 0)
+			{
+				P += 2 * dx;
+				y += addy;
+			}
+			else
+			{
+				P += 2 * dx - 2 * dy;
+				x += addx;
+				y += addy;
+			}
+		}
+	}
+}
+
+/**
+  * @brief  Draw a circle
+  * @param  x: x center coordinate
+  * @param  y: y center coordinate
+  * @param  radius: radius of circle
+  * @param  clipped: test every pixel against the clip rectangle
+  * @retval None.
+  */
+static inline void SD1306_ROP_FN(sd1306_circle)(int32_t x, int32_t y, int32_t radius, const uint8_t clipped)
+{
+	int32_t a;
+	int32_t b;
+	int32_t P;
+	a = 0x00;
+	b = radius;
+	P = 0x01 - radius;
+
+	do
+	{
+		SD1306_ROP_FN(sd1306_plot)(a + x, b + y, clipped);
+		SD1306_ROP_FN(sd1306_plot)(b + x, a + y, clipped);
+		SD1306_ROP_FN(sd1306_plot)(x - a, b + y, clipped);
+		SD1306_ROP_FN(sd1306_plot)(x - b, a + y, clipped);
+		SD1306_ROP_FN(sd1306_plot)(b + x, y - a, clipped);
+		SD1306_ROP_FN(sd1306_plot)(a + x, y - b, clipped);
+		SD1306_ROP_FN(sd1306_plot)(x - a, y - b, clipped);
+		SD1306_ROP_FN(sd1306_plot)(x - b, y - a, clipped);
+
+		if (P < 0)
+		{
+			P += 3 + 2 * a++;
+		}
+		else
+		{
+			P += 5 + 2 * (a++ - b--);
+		}
+
+	} while (a <= b);
+}
+
+/**
+  * @brief  Draw quarter circles, used to do round rectangles
+  * @param  x0: x center coordinate
+  * @param  y0: y center coordinate
+  * @param  radius: radius
+  * @param  cornername: corner to draw the semicircle
+  * @param  clipped: test every pixel against the clip rectangle
+  * @retval None.
+  */
+static inline void SD1306_ROP_FN(sd1306_circle_corners)(int32_t x0, int32_t y0, int32_t radius, uint8_t cornername, const uint8_t clipped)
+{
+	int32_t f = 1 - radius;
+	int32_t ddF_x = 1;
+	int32_t ddF_y = -2 * radius;
+	int32_t x = 0;
+	int32_t y = radius;
+
+	while (x < y)
+	{
+		if (f >= 0)
+		{
+			y--;
+			ddF_y += 2;
+			f += ddF_y;
+		}
+		x++;
+		ddF_x += 2;
+		f += ddF_x;
+		if (cornername & 0x4)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x0 + x, y0 + y, clipped);
+			SD1306_ROP_FN(sd1306_plot)(x0 + y, y0 + x, clipped);
+		}
+		if (cornername & 0x2)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x0 + x, y0 - y, clipped);
+			SD1306_ROP_FN(sd1306_plot)(x0 + y, y0 - x, clipped);
+		}
+		if (cornername & 0x8)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x0 - y, y0 + x, clipped);
+			SD1306_ROP_FN(sd1306_plot)(x0 - x, y0 + y, clipped);
+		}
+		if (cornername & 0x1)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x0 - y, y0 - x, clipped);
+			SD1306_ROP_FN(sd1306_plot)(x0 - x, y0 - y, clipped);
+		}
+	}
+}
+
+/**
+  * @brief  Draw the points of a circle that are inside the angles of an arc
+  * @param  x: x center coordinate
+  * @param  y: y center coordinate
+  * @param  radius: radius of arc
+  * @param  arc: angles of the arc
+  * @param  clipped: test every pixel against the clip rectangle
+  * @retval None.
+  */
+static inline void SD1306_ROP_FN(sd1306_arc_points)(int32_t x, int32_t y, int32_t radius, const struct sd1306_arc* arc, const uint8_t clipped)
+{
+	int32_t a;
+	int32_t b;
+	int32_t P;
+	a = 0x00;
+	b = radius;
+	P = 0x01 - radius;
+
+	do
+	{
+		// One point per octant. Points on the axes (a == 0) and on the diagonals (a == b) are
+		// shared by two octants and only drawn once, so inverse_pixel does not cancel them.
+		if (sd1306_arc_contains(arc, b, a, 0) && a != b)
+		{
+			SD1306_ROP_FN(sd1306_plot)(b + x, y - a, clipped);
+		}
+		if (sd1306_arc_contains(arc, a, b, 1))
+		{
+			SD1306_ROP_FN(sd1306_plot)(a + x, y - b, clipped);
+		}
+		if (sd1306_arc_contains(arc, -a, b, 2) && a != 0)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x - a, y - b, clipped);
+		}
+		if (sd1306_arc_contains(arc, -b, a, 3) && a != b)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x - b, y - a, clipped);
+		}
+		if (sd1306_arc_contains(arc, -b, -a, 4) && a != 0 && a != b)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x - b, y + a, clipped);
+		}
+		if (sd1306_arc_contains(arc, -a, -b, 5) && a != 0)
+		{
+			SD1306_ROP_FN(sd1306_plot)(x - a, y + b, clipped);
+		}
+		if (sd1306_arc_contains(arc, a, -b, 6) && a != b)
+		{
+			SD1306_ROP_FN(sd1306_plot)(a + x, y + b, clipped);
+		}
+		if (sd1306_arc_contains(arc, b, -a, 7) && a != 0)
+		{
+			SD1306_ROP_FN(sd1306_plot)(b + x, y + a, clipped);
+		}
+
+		if (P < 0)
+		{
+			P += 3 + 2 * a++;
+		}
+		else
+		{
+			P += 5 + 2 * (a++ - b--);
+		}
+
+	} while (a <= b);
+}
+
+#undef SD1306_ROP_NAME
+#undef SD1306_ROP
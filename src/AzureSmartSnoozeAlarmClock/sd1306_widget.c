@@ -0,0 +1,115 @@
+/***************************************************************************************************
+   Name: sd1306_widget.c
+   Sphere OS: 19.05
+****************************************************************************************************/
+
+#include "sd1306_widget.h"
+
+/**
+  * @brief  Set up a widget, it starts visible with no text
+  * @param  widget: widget to set up
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: widget width
+  * @param  height: widget height, at most 64
+  * @param  size: text scale
+  * @param  large_digits: draw digits, colon and space with the large digit face, size must be 4
+  * @retval None.
+  */
+void sd1306_widget_init(struct sd1306_widget* widget, int32_t x, int32_t y, int32_t width, int32_t height, int32_t size, uint8_t large_digits)
+{
+	widget->x = x;
+	widget->y = y;
+	widget->width = width;
+	widget->height = height;
+	widget->size = size;
+	widget->large_digits = large_digits;
+	widget->visible = 1;
+	widget->text[0] = 0x00;
+	widget->stale = 1;
+	widget->changed = 1;
+}
+
+/**
+  * @brief  Change the text of a widget, nothing is rendered if the text is the same
+  * @param  widget: widget to change
+  * @param  text: new text, cut to SD1306_WIDGET_TEXT - 1 characters
+  * @retval None.
+  */
+void sd1306_widget_set_text(struct sd1306_widget* widget, const char* text)
+{
+	if (strncmp(widget->text, text, SD1306_WIDGET_TEXT - 1) == 0)
+	{
+		return;
+	}
+
+	strncpy(widget->text, text, SD1306_WIDGET_TEXT - 1);
+	widget->text[SD1306_WIDGET_TEXT - 1] = 0x00;
+	widget->stale = 1;
+	widget->changed = 1;
+}
+
+/**
+  * @brief  Show or hide a widget, a hidden widget leaves its rectangle black
+  * @param  widget: widget to change
+  * @param  visible: nonzero to show the widget
+  * @retval None.
+  */
+void sd1306_widget_set_visible(struct sd1306_widget* widget, uint8_t visible)
+{
+	visible = visible != 0;
+	if (widget->visible != visible)
+	{
+		widget->visible = visible;
+		widget->changed = 1;
+	}
+}
+
+/**
+  * @brief  Composite widgets into OLED buffer, rendering the ones whose text changed
+  * @param  widgets: widgets of the screen, they must not overlap
+  * @param  count: number of widgets
+  * @param  redraw: nonzero when OLED buffer holds something else, clears it and composites all widgets
+  * @retval Nonzero if OLED buffer changed.
+  */
+uint8_t sd1306_compose(struct sd1306_widget* const* widgets, uint8_t count, uint8_t redraw)
+{
+	struct sd1306_widget* widget;
+	uint8_t composed = 0;
+	uint8_t i;
+
+	if (redraw)
+	{
+		clear_oled_buffer();
+		composed = 1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		widget = widgets[i];
+		if (!widget->changed && !redraw)
+		{
+			continue;
+		}
+
+		if (widget->visible && widget->stale)
+		{
+			sd1306_render_string_columns(widget->cache, widget->width, widget->height,
+				(const uint8_t*)widget->text, widget->size, widget->large_digits);
+			widget->stale = 0;
+		}
+
+		// Only the widget's own rectangle is touched, the rest of OLED buffer stays as it is
+		if (!redraw)
+		{
+			sd1306_clear_rect(widget->x, widget->y, widget->width, widget->height);
+		}
+		if (widget->visible)
+		{
+			sd1306_draw_columns(widget->x, widget->y, widget->cache, widget->width, widget->height, white_pixel);
+		}
+		widget->changed = 0;
+		composed = 1;
+	}
+	return composed;
+}
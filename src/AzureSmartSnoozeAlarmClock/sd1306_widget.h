@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef HEADER_sd1306_widget_H
+#define HEADER_sd1306_widget_H
+
+#include "sd1306.h"
+
+// Longest widget text, terminator included
+#define SD1306_WIDGET_TEXT 16
+
+// A line of text drawn white on black in its own rectangle of OLED buffer. The text is rendered
+// into cache when it changes and composited into OLED buffer from there.
+struct sd1306_widget
+{
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+	int32_t size;
+	uint8_t large_digits;
+	uint8_t visible;
+	char text[SD1306_WIDGET_TEXT];
+	// Text changed since cache was rendered
+	uint8_t stale;
+	// Text or visibility changed since the widget was composited
+	uint8_t changed;
+	// Rendered text, pages rows of width bytes
+	uint8_t cache[BUFFER_SIZE];
+};
+
+/**
+  * @brief  Set up a widget, it starts visible with no text
+  * @param  widget: widget to set up
+  * @param  x: x coordinate
+  * @param  y: y coordinate
+  * @param  width: widget width
+  * @param  height: widget height, at most 64
+  * @param  size: text scale
+  * @param  large_digits: draw digits, colon and space with the large digit face, size must be 4
+  * @retval None.
+  */
+extern void sd1306_widget_init(struct sd1306_widget* widget, int32_t x, int32_t y, int32_t width, int32_t height, int32_t size, uint8_t large_digits);
+
+/**
+  * @brief  Change the text of a widget, nothing is rendered if the text is the same
+  * @param  widget: widget to change
+  * @param  text: new text, cut to SD1306_WIDGET_TEXT - 1 characters
+  * @retval None.
+  */
+extern void sd1306_widget_set_text(struct sd1306_widget* widget, const char* text);
+
+/**
+  * @brief  Show or hide a widget, a hidden widget leaves its rectangle black
+  * @param  widget: widget to change
+  * @param  visible: nonzero to show the widget
+  * @retval None.
+  */
+extern void sd1306_widget_set_visible(struct sd1306_widget* widget, uint8_t visible);
+
+/**
+  * @brief  Composite widgets into OLED buffer, rendering the ones whose text changed
+  * @param  widgets: widgets of the screen, they must not overlap
+  * @param  count: number of widgets
+  * @param  redraw: nonzero when OLED buffer holds something else, clears it and composites all widgets
+  * @retval Nonzero if OLED buffer changed.
+  */
+extern uint8_t sd1306_compose(struct sd1306_widget* const* widgets, uint8_t count, uint8_t redraw);
+
+#endif
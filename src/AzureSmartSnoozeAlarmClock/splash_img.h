@@ -0,0 +1,40 @@
+#pragma once
+
+// Generated by tools/imgpack/imgpack.c from splash.pbm, do not edit.
+// 128x64, 472 bytes instead of 1024, draw with sd1306_draw_packed_img.
+
+#include <stdint.h>
+
+static const uint8_t splash_img[472] =
+{
+	0x80, 0x08, 0x00, 0x04, 0xF0, 0x08, 0xE4, 0x12, 0x09, 0xF4, 0x05, 0x11, 0x09, 0x12, 0xE4, 0x08,
+	0xF0, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0x87, 0x0E,
+	0x16, 0x70, 0x70, 0x70, 0x00, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80,
+	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x87, 0x80, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x87, 0x80, 0x03, 0x00, 0x00, 0x00, 0x00, 0x8D, 0x80, 0x03, 0x00, 0x00, 0x00, 0x00,
+	0x87, 0x80, 0x95, 0x00, 0x0F, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x03, 0x03, 0x03, 0x87, 0x1C, 0x16, 0xE0, 0xE0, 0xE0, 0x00, 0xFF, 0xFF, 0xFF, 0x1C,
+	0x1C, 0x1C, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xFC, 0xFC, 0xFC, 0x00, 0xFC, 0xFC, 0xFC, 0x87,
+	0x03, 0x06, 0xFC, 0xFC, 0xFC, 0x00, 0xFC, 0xFC, 0xFC, 0x87, 0x03, 0x16, 0xFC, 0xFC, 0xFC, 0x00,
+	0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xE3, 0xE3, 0xE3, 0x1F, 0x1F, 0x1F, 0x03, 0x03, 0x03, 0x00,
+	0xFC, 0xFC, 0xFC, 0x87, 0xE3, 0x02, 0xFC, 0xFC, 0xFC, 0x92, 0x00, 0x0F, 0xFF, 0x00, 0xFF, 0xFF,
+	0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x07, 0x07, 0x87, 0x38, 0x06, 0x07,
+	0x07, 0x07, 0x00, 0x3F, 0x3F, 0x3F, 0x87, 0x00, 0x06, 0x3F, 0x3F, 0x3F, 0x00, 0x07, 0x07, 0x07,
+	0x87, 0x38, 0x06, 0x07, 0x07, 0x07, 0x00, 0x07, 0x07, 0x07, 0x87, 0x38, 0x09, 0x07, 0x07, 0x07,
+	0x00, 0x38, 0x38, 0x38, 0x3F, 0x3F, 0x3F, 0x87, 0x38, 0x03, 0x00, 0x07, 0x07, 0x07, 0x87, 0x38,
+	0x95, 0x00, 0x0C, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xEA, 0x02, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0xFF,
+	0x8B, 0x00, 0x56, 0x3C, 0x3C, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0x0C, 0x0C, 0x00, 0x30, 0x30,
+	0x30, 0x30, 0xFF, 0xFF, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x30, 0x30, 0x30, 0x30, 0x30,
+	0x30, 0xC0, 0xC0, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xC0, 0xC0, 0x30, 0x30, 0x30, 0x30, 0x00, 0x30,
+	0x30, 0x30, 0x30, 0xFF, 0xFF, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x30, 0x30, 0xF3, 0xF3,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xC0, 0xC0, 0x30, 0x30, 0x30, 0x30, 0xC0, 0xC0, 0x00,
+	0xC0, 0xC0, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0xF0, 0xF0, 0x94, 0x00, 0x05, 0xFF, 0x00, 0xFF,
+	0xFF, 0x00, 0xFF, 0x8B, 0x00, 0x24, 0x0C, 0x0C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x0F, 0x0F,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x30, 0x30, 0x30, 0x30, 0x00, 0x0C, 0x0C, 0x33, 0x33,
+	0x33, 0x33, 0x33, 0x33, 0x3F, 0x3F, 0x00, 0x00, 0x00, 0x3F, 0x3F, 0x89, 0x00, 0x26, 0x0F, 0x0F,
+	0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x30, 0x30, 0x3F, 0x3F, 0x30, 0x30, 0x00, 0x00, 0x00,
+	0x3F, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x3F, 0x00, 0x00, 0x00, 0x33, 0x33, 0x33,
+	0x33, 0x33, 0x33, 0x0F, 0x0F, 0x94, 0x00, 0x07, 0xFF, 0x00, 0xFF, 0x0F, 0x10, 0x27, 0x48, 0x90,
+	0xF4, 0xA0, 0x04, 0x90, 0x48, 0x27, 0x10, 0x0F,
+};
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "state_machine.h"
+
+enum runningState currentState = Normal;
+AlarmTime alarmTime = { .hour = 0, .minute = 0, .offsetSeconds = 0, .currentAlarmTime = 0, .active = false};
+char timezone[TIME_ZONE_LENGTH + 1] = { 0 };
+ButtonDebounce buttonDebounce[ButtonCount];
+
+static StateMachineHooks stateMachineHooks;
+
+void setStateMachineHooks(const StateMachineHooks* hooks) {
+	stateMachineHooks = *hooks;
+}
+
+static void showAlarm(void) {
+	currentState = DisplayAlarm;
+}
+
+static void closeAlarm(void) {
+	stateMachineHooks.saveSettings();
+	currentState = Normal;
+}
+
+static void showSettings(void) {
+	currentState = SetSettings;
+}
+
+static void showSetAlarmHour(void) {
+	currentState = SetAlarmHour;
+}
+
+static void showSetAlarmMinute(void) {
+	currentState = SetAlarmMinute;
+}
+
+static void showSetTimeZone(void) {
+	currentState = SetTimeZone;
+}
+
+static void decrementAlarmHour(void) {
+	alarmTime.hour = (alarmTime.hour + 23) % 24;
+}
+
+static void incrementAlarmHour(void) {
+	alarmTime.hour = (alarmTime.hour + 1) % 24;
+}
+
+static void decrementAlarmMinute(void) {
+	alarmTime.minute = (alarmTime.minute + 59) % 60;
+}
+
+static void incrementAlarmMinute(void) {
+	alarmTime.minute = (alarmTime.minute + 1) % 60;
+}
+
+static void saveAlarmTime(void) {
+	alarmTime.offsetSeconds = 0;
+	stateMachineHooks.saveSettings();
+	stateMachineHooks.setCurrentAlarm();
+	currentState = Normal;
+}
+
+static void toggleAlarmActive(void) {
+	alarmTime.active = !alarmTime.active;
+}
+
+static void toggleTimeZoneSign(void) {
+	timezone[0] = (timezone[0] == '+' ? '-' : '+');
+}
+
+static void decrementTimeZoneHours(void) {
+	char* hourString = &timezone[1];
+	unsigned int hours = ((unsigned int)atoi(hourString) + 23) % 24;
+	snprintf(hourString, TIME_ZONE_LENGTH, "%02u", hours);
+}
+
+static void incrementTimeZoneHours(void) {
+	char* hourString = &timezone[1];
+	unsigned int hours = ((unsigned int)atoi(hourString) + 1) % 24;
+	snprintf(hourString, TIME_ZONE_LENGTH, "%02u", hours);
+}
+
+static void saveTimeZone(void) {
+	if (stateMachineHooks.setTimeZone() != 0) {
+		return;
+	}
+	stateMachineHooks.saveSettings();
+	// The alarm is set in local time, so it moves with the zone
+	stateMachineHooks.setCurrentAlarm();
+	currentState = Normal;
+}
+
+static void endAlarm(void) {
+	currentState = Normal;
+	stateMachineHooks.endSoundAlarm();
+}
+
+static void snooze(void) {
+	currentState = Snooze;
+	stateMachineHooks.startSnooze();
+}
+
+// What a debounced edge of a button does in each state, every edge also redraws
+const ButtonAction buttonTransitions[StateCount][ButtonCount][EdgeCount] = {
+	[Normal][ButtonA][ButtonPressed] = showAlarm,
+	[Normal][ButtonSet][ButtonPressed] = showSettings,
+
+	[DisplayAlarm][ButtonA][ButtonReleased] = closeAlarm,
+	[DisplayAlarm][ButtonC][ButtonPressed] = toggleAlarmActive,
+
+	[SetSettings][ButtonA][ButtonPressed] = showSetAlarmHour,
+	[SetSettings][ButtonC][ButtonPressed] = showSetTimeZone,
+
+	[SetAlarmHour][ButtonA][ButtonPressed] = decrementAlarmHour,
+	[SetAlarmHour][ButtonB][ButtonPressed] = incrementAlarmHour,
+	[SetAlarmHour][ButtonSet][ButtonReleased] = showSetAlarmMinute,
+
+	[SetAlarmMinute][ButtonA][ButtonPressed] = decrementAlarmMinute,
+	[SetAlarmMinute][ButtonB][ButtonPressed] = incrementAlarmMinute,
+	[SetAlarmMinute][ButtonSet][ButtonReleased] = saveAlarmTime,
+
+	[SetTimeZone][ButtonA][ButtonPressed] = toggleTimeZoneSign,
+	[SetTimeZone][ButtonB][ButtonPressed] = decrementTimeZoneHours,
+	[SetTimeZone][ButtonC][ButtonPressed] = incrementTimeZoneHours,
+	[SetTimeZone][ButtonSet][ButtonReleased] = saveTimeZone,
+
+	[SoundAlarm][ButtonA][ButtonPressed] = endAlarm,
+	[SoundAlarm][ButtonA][ButtonReleased] = endAlarm,
+	[SoundAlarm][ButtonSet][ButtonPressed] = snooze,
+	[SoundAlarm][ButtonSet][ButtonReleased] = snooze,
+
+	[Snooze][ButtonA][ButtonPressed] = endAlarm,
+	[Snooze][ButtonA][ButtonReleased] = endAlarm
+};
+
+void resetButton(enum buttonName button, bool pressed) {
+	buttonDebounce[button].pressed = pressed;
+	buttonDebounce[button].count = 0;
+}
+
+bool sampleButton(enum buttonName button, bool pressed) {
+	ButtonDebounce* b = &buttonDebounce[button];
+
+	if (pressed == b->pressed) {
+		b->count = 0;
+		return pressed;
+	}
+	if (++b->count < BUTTON_DEBOUNCE_SAMPLES) {
+		return true;
+	}
+	b->count = 0;
+	b->pressed = pressed;
+
+	ButtonAction action = buttonTransitions[currentState][button][pressed ? ButtonPressed : ButtonReleased];
+	if (action != NULL) {
+		action();
+	}
+	stateMachineHooks.requestRender();
+	return true;
+}
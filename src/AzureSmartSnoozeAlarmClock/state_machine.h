@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Samples in a row a button has to read at a new level before it counts as an edge
+#define BUTTON_DEBOUNCE_SAMPLES 4
+// Time zone text, a sign and two digits of hours
+#define TIME_ZONE_LENGTH 3
+
+enum buttonName {ButtonA, ButtonB, ButtonC, ButtonSet, ButtonCount};
+enum buttonEdge {ButtonPressed, ButtonReleased, EdgeCount};
+enum runningState{ Normal, DisplayAlarm, SetSettings, SetTimeZone, SetAlarmHour, SetAlarmMinute, SoundAlarm, Snooze, StateCount };
+typedef struct AlarmTime {
+	uint8_t hour;
+	uint8_t minute;
+	uint16_t offsetSeconds;
+	time_t currentAlarmTime;
+	bool active;
+} AlarmTime;
+typedef struct ButtonDebounce {
+	// Debounced level, true while the button is held down
+	bool pressed;
+	// Samples in a row that read a different level than pressed
+	uint8_t count;
+} ButtonDebounce;
+typedef void (*ButtonAction)(void);
+// What the transitions need done outside the state machine, main.c fills it in
+typedef struct StateMachineHooks {
+	int (*saveSettings)(void);
+	// Works the alarm time out again from alarmTime.hour and alarmTime.minute
+	void (*setCurrentAlarm)(void);
+	// Applies timezone, nonzero if it could not
+	int (*setTimeZone)(void);
+	// The alarm was turned off, currentState is already Normal
+	void (*endSoundAlarm)(void);
+	// Snooze started, currentState is already Snooze
+	void (*startSnooze)(void);
+	void (*requestRender)(void);
+} StateMachineHooks;
+
+extern enum runningState currentState;
+extern AlarmTime alarmTime;
+extern char timezone[TIME_ZONE_LENGTH + 1];
+extern ButtonDebounce buttonDebounce[ButtonCount];
+extern const ButtonAction buttonTransitions[StateCount][ButtonCount][EdgeCount];
+
+void setStateMachineHooks(const StateMachineHooks* hooks);
+// Starts a button off at a level without an edge, so one held down at startup is not a press
+void resetButton(enum buttonName button, bool pressed);
+// Feeds one sample of a button and runs the transition of a debounced edge, true while it is settling or held down
+bool sampleButton(enum buttonName button, bool pressed);
@@ -0,0 +1,235 @@
+/***************************************************************************************************
+   Name: fontgen.c
+   Host tool that turns a column major bitmap font into the pre-scaled, page native glyph atlases
+   sd1306.c draws strings from.
+
+   Build and run on the development machine from this directory:
+      gcc -o fontgen fontgen.c
+      ./fontgen 2 3 4 > ../../src/AzureSmartSnoozeAlarmClock/font_atlas.h
+
+   The arguments are the scales to emit. Another font can be used by building with
+   -DFONT_HEADER='"myfont.h"' -DFONT_TABLE=myfont_data and, if they differ from the 5x7 font.h,
+   -DFONT_WIDTH, -DFONT_HEIGHT and -DFONT_FIRST. The font table must be laid out like font.h: one
+   entry per character, one byte per column, bit 0 the top row.
+****************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef FONT_HEADER
+#define FONT_HEADER "../../src/AzureSmartSnoozeAlarmClock/font.h"
+#define FONT_TABLE font_data
+#endif
+#ifndef FONT_WIDTH
+#define FONT_WIDTH 5
+#endif
+#ifndef FONT_HEIGHT
+#define FONT_HEIGHT 7
+#endif
+#ifndef FONT_FIRST
+#define FONT_FIRST ' '
+#endif
+
+#include FONT_HEADER
+
+// Atlases cover the printable ASCII characters
+#define ATLAS_FIRST ' '
+#define ATLAS_LAST '~'
+#define ATLAS_CHARACTERS (ATLAS_LAST - ATLAS_FIRST + 1)
+
+// Characters of the large digit face
+static const char large_digits[] = "0123456789: ";
+
+#define MAX_SCALE 8
+#define MAX_WIDTH (FONT_WIDTH * MAX_SCALE)
+#define MAX_HEIGHT (FONT_HEIGHT * MAX_SCALE)
+
+// Glyph as one byte per pixel, [row][column]
+typedef struct Glyph
+{
+	int width;
+	int height;
+	uint8_t pixels[MAX_HEIGHT][MAX_WIDTH];
+} Glyph;
+
+/**
+  * @brief  Unpack a character of the font into a glyph.
+  * @param  character: character to unpack
+  * @param  glyph: unpacked glyph
+  * @retval None.
+  */
+static void load_glyph(char character, Glyph* glyph)
+{
+	const uint8_t* columns = FONT_TABLE[character - FONT_FIRST];
+
+	glyph->width = FONT_WIDTH;
+	glyph->height = FONT_HEIGHT;
+	for (int row = 0; row < FONT_HEIGHT; row++)
+	{
+		for (int column = 0; column < FONT_WIDTH; column++)
+		{
+			glyph->pixels[row][column] = (columns[column] >> row) & 1;
+		}
+	}
+}
+
+/**
+  * @brief  Stretch a glyph by repeating every pixel.
+  * @param  in: glyph to stretch
+  * @param  scale: scale
+  * @param  out: stretched glyph
+  * @retval None.
+  */
+static void scale_glyph(const Glyph* in, int scale, Glyph* out)
+{
+	out->width = in->width * scale;
+	out->height = in->height * scale;
+	for (int row = 0; row < out->height; row++)
+	{
+		for (int column = 0; column < out->width; column++)
+		{
+			out->pixels[row][column] = in->pixels[row / scale][column / scale];
+		}
+	}
+}
+
+/**
+  * @brief  Double a glyph with the Scale2x (EPX) rules, which round off diagonal steps.
+  * @param  in: glyph to double
+  * @param  out: doubled glyph
+  * @retval None.
+  */
+static void scale2x_glyph(const Glyph* in, Glyph* out)
+{
+	out->width = in->width * 2;
+	out->height = in->height * 2;
+	for (int row = 0; row < in->height; row++)
+	{
+		for (int column = 0; column < in->width; column++)
+		{
+			// Neighbours past the edge are background
+			uint8_t p = in->pixels[row][column];
+			uint8_t above = row > 0 ? in->pixels[row - 1][column] : 0;
+			uint8_t below = row < in->height - 1 ? in->pixels[row + 1][column] : 0;
+			uint8_t left = column > 0 ? in->pixels[row][column - 1] : 0;
+			uint8_t right = column < in->width - 1 ? in->pixels[row][column + 1] : 0;
+
+			out->pixels[2 * row][2 * column] = (left == above && left != below && above != right) ? above : p;
+			out->pixels[2 * row][2 * column + 1] = (above == right && above != left && right != below) ? right : p;
+			out->pixels[2 * row + 1][2 * column] = (below == left && below != right && left != above) ? left : p;
+			out->pixels[2 * row + 1][2 * column + 1] = (right == below && right != above && below != left) ? below : p;
+		}
+	}
+}
+
+/**
+  * @brief  Print a glyph as page rows of column bytes, bit 0 the top row of the page.
+  * @param  glyph: glyph to print
+  * @param  pages: number of pages to print
+  * @param  name: comment for the entry
+  * @retval None.
+  */
+static void print_glyph(const Glyph* glyph, int pages, const char* name)
+{
+	printf("\t{ // %s\n", name);
+	for (int page = 0; page < pages; page++)
+	{
+		printf("\t\t{");
+		for (int column = 0; column < glyph->width; column++)
+		{
+			uint8_t bits = 0;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				int row = page * 8 + bit;
+				if (row < glyph->height && glyph->pixels[row][column])
+				{
+					bits |= 1 << bit;
+				}
+			}
+			printf("%s0x%02X", column ? ", " : " ", bits);
+		}
+		printf(" },\n");
+	}
+	printf("\t},\n");
+}
+
+/**
+  * @brief  Comment naming a character.
+  * @param  character: character to name
+  * @retval Static string with the name.
+  */
+static const char* character_name(char character)
+{
+	static char name[16];
+
+	if (character == ' ')
+	{
+		return "SPACE";
+	}
+	// A backslash would continue the comment onto the next line
+	if (character == '\\')
+	{
+		return "BACKSLASH";
+	}
+	snprintf(name, sizeof(name), "%c", character);
+	return name;
+}
+
+int main(int argc, char* argv[])
+{
+	Glyph glyph;
+	Glyph scaled;
+	Glyph doubled;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s scale [scale ...] > font_atlas.h\n", argv[0]);
+		return 1;
+	}
+
+	printf("#pragma once\n\n");
+	printf("// Generated by tools/fontgen/fontgen.c from %s, do not edit.\n\n", FONT_HEADER);
+	printf("#include <stdint.h>\n\n");
+	printf("#define FONT_ATLAS_FIRST '%c'\n", ATLAS_FIRST);
+	printf("#define FONT_ATLAS_LAST '%c'\n", ATLAS_LAST);
+
+	for (int i = 1; i < argc; i++)
+	{
+		int scale = atoi(argv[i]);
+		if (scale < 2 || scale > MAX_SCALE)
+		{
+			fprintf(stderr, "Scale %s is not between 2 and %d\n", argv[i], MAX_SCALE);
+			return 1;
+		}
+		int pages = (FONT_HEIGHT * scale + 7) / 8;
+
+		printf("\n// Font stretched %d times, [character - FONT_ATLAS_FIRST][page][column]\n", scale);
+		printf("#define FONT_ATLAS_%dX\n", scale);
+		printf("const uint8_t font_atlas_%dx[%d][%d][%d] =\n{\n", scale, ATLAS_CHARACTERS, pages, FONT_WIDTH * scale);
+		for (char character = ATLAS_FIRST; character <= ATLAS_LAST; character++)
+		{
+			load_glyph(character, &glyph);
+			scale_glyph(&glyph, scale, &scaled);
+			print_glyph(&scaled, pages, character_name(character));
+		}
+		printf("};\n");
+	}
+
+	// Digits for the time display, Scale2x twice keeps the 4x metrics with rounded strokes
+	int large_pages = (FONT_HEIGHT * 4 + 7) / 8;
+	printf("\n// Large digit face with the metrics of the 4x font, characters in FONT_LARGE_DIGITS order\n");
+	printf("#define FONT_LARGE_DIGITS \"%s\"\n", large_digits);
+	printf("const uint8_t font_large_digits[%d][%d][%d] =\n{\n", (int)strlen(large_digits), large_pages, FONT_WIDTH * 4);
+	for (const char* character = large_digits; *character; character++)
+	{
+		load_glyph(*character, &glyph);
+		scale2x_glyph(&glyph, &doubled);
+		scale2x_glyph(&doubled, &scaled);
+		print_glyph(&scaled, large_pages, character_name(*character));
+	}
+	printf("};\n");
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-in for the applibs I2C master API, see i2c_host.c
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef int I2C_InterfaceId;
+typedef uint32_t I2C_DeviceAddress;
+
+#define I2C_BUS_SPEED_STANDARD 100000
+#define I2C_BUS_SPEED_FAST 400000
+#define I2C_BUS_SPEED_FAST_PLUS 1000000
+
+int I2CMaster_Open(I2C_InterfaceId id);
+int I2CMaster_SetBusSpeed(int fd, uint32_t speedInHz);
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutInMs);
+ssize_t I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t* data, size_t length);
+
+// What the bus and the device on it accept. Writes take the time their bits need at the speed set.
+struct i2c_host_bus
+{
+	// Fastest speed the controller accepts, I2CMaster_SetBusSpeed fails with EINVAL above it
+	uint32_t max_speed;
+	// Fastest speed the device ACKs at, writes fail with EIO above it
+	uint32_t max_device_speed;
+	// Speed set last and the fastest ever set
+	uint32_t speed;
+	uint32_t fastest_set;
+	uint32_t writes;
+};
+
+extern struct i2c_host_bus i2c_host_bus;
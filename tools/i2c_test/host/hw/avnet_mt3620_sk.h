@@ -0,0 +1,3 @@
+#pragma once
+
+#define AVNET_MT3620_SK_ISU2_I2C 2
@@ -0,0 +1,70 @@
+/***************************************************************************************************
+   Name: i2c_host.c
+   Host stand-in for the applibs I2C master calls i2c.c makes, so bus speed negotiation can be
+   tested on a PC. The bus is described by i2c_host_bus.
+****************************************************************************************************/
+
+#include <errno.h>
+#include <time.h>
+#include <applibs/i2c.h>
+
+// Fds the stand-in hands out, any number that is not a real open file will do
+#define I2C_HOST_FD 1000
+// Bits on the wire per byte, eight and the ACK
+#define I2C_HOST_BITS_PER_BYTE 9
+
+struct i2c_host_bus i2c_host_bus;
+
+int I2CMaster_Open(I2C_InterfaceId id)
+{
+	(void)id;
+	return I2C_HOST_FD;
+}
+
+int I2CMaster_SetBusSpeed(int fd, uint32_t speedInHz)
+{
+	if (fd != I2C_HOST_FD || speedInHz > i2c_host_bus.max_speed)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	i2c_host_bus.speed = speedInHz;
+	if (speedInHz > i2c_host_bus.fastest_set)
+	{
+		i2c_host_bus.fastest_set = speedInHz;
+	}
+	return 0;
+}
+
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutInMs)
+{
+	(void)timeoutInMs;
+	if (fd != I2C_HOST_FD)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+ssize_t I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t* data, size_t length)
+{
+	(void)address;
+	(void)data;
+	if (fd != I2C_HOST_FD || i2c_host_bus.speed == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (i2c_host_bus.speed > i2c_host_bus.max_device_speed)
+	{
+		errno = EIO;
+		return -1;
+	}
+
+	uint64_t ns = (uint64_t)length * I2C_HOST_BITS_PER_BYTE * 1000000000 / i2c_host_bus.speed;
+	struct timespec wire = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+	nanosleep(&wire, NULL);
+	i2c_host_bus.writes++;
+	return (ssize_t)length;
+}
@@ -0,0 +1,130 @@
+/***************************************************************************************************
+   Name: i2c_test.c
+   Host test of the I2C bus speed negotiation in i2c.c against the stand-in bus of i2c_host.c.
+   Exits non-zero if a check fails.
+
+   Build and run on the development machine from this directory, once as the device builds it and
+   once with fast-mode-plus allowed:
+      gcc -Wall -Wextra -Ihost -I../../src/AzureSmartSnoozeAlarmClock -o i2c_test i2c_test.c i2c_host.c \
+         ../../src/AzureSmartSnoozeAlarmClock/i2c.c
+      ./i2c_test
+      gcc -Wall -Wextra -DI2C_MAX_BUS_SPEED=I2C_BUS_SPEED_FAST_PLUS -Ihost -I../../src/AzureSmartSnoozeAlarmClock \
+         -o i2c_test_fmp i2c_test.c i2c_host.c ../../src/AzureSmartSnoozeAlarmClock/i2c.c
+      ./i2c_test_fmp
+****************************************************************************************************/
+
+#include <stdio.h>
+#include <applibs/i2c.h>
+#include "i2c.h"
+
+#define TEST_ADDRESS 0x3c
+
+#define CHECK(condition) check((condition), #condition, __func__, __LINE__)
+
+static int failures;
+
+static void check(int passed, const char* condition, const char* test, int line)
+{
+	if (!passed)
+	{
+		printf("FAIL %s:%d: %s\n", test, line, condition);
+		failures++;
+	}
+}
+
+// Opens the bus afresh at standard speed, as the app does at startup
+static void setup_bus(uint32_t max_speed, uint32_t max_device_speed)
+{
+	i2c_host_bus = (struct i2c_host_bus){ .max_speed = max_speed, .max_device_speed = max_device_speed };
+	CHECK(initI2c() == 0);
+	i2c_host_bus.fastest_set = 0;
+}
+
+// Measured throughput should be near what the speed moves, 9 bits a byte, allowing for a slow host
+static int plausible_rate(uint32_t speed)
+{
+	uint32_t rate = getI2cBytesPerSecond();
+	return rate > speed / 9 / 4 && rate <= speed / 9 + speed / 90;
+}
+
+static void test_getters_before_negotiation(void)
+{
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST_PLUS);
+	CHECK(getI2cBusSpeed() == I2C_BUS_SPEED_STANDARD);
+	CHECK(getI2cBytesPerSecond() == 0);
+}
+
+static void test_picks_fastest_allowed(void)
+{
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST_PLUS);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == 0);
+	CHECK(getI2cBusSpeed() == I2C_MAX_BUS_SPEED);
+	CHECK(i2c_host_bus.speed == I2C_MAX_BUS_SPEED);
+	CHECK(i2c_host_bus.fastest_set == I2C_MAX_BUS_SPEED);
+	CHECK(plausible_rate(I2C_MAX_BUS_SPEED));
+}
+
+static void test_fast_plus_rejected(void)
+{
+	// The controller refuses fast-mode-plus
+	setup_bus(I2C_BUS_SPEED_FAST, I2C_BUS_SPEED_FAST_PLUS);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == 0);
+	CHECK(getI2cBusSpeed() == I2C_BUS_SPEED_FAST);
+	CHECK(i2c_host_bus.speed == I2C_BUS_SPEED_FAST);
+	CHECK(plausible_rate(I2C_BUS_SPEED_FAST));
+}
+
+static void test_fast_plus_not_acked(void)
+{
+	// The controller takes fast-mode-plus but the display does not answer at it
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == 0);
+	CHECK(getI2cBusSpeed() == I2C_BUS_SPEED_FAST);
+	CHECK(i2c_host_bus.speed == I2C_BUS_SPEED_FAST);
+}
+
+static void test_fast_not_acked(void)
+{
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_STANDARD);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == 0);
+	CHECK(getI2cBusSpeed() == I2C_BUS_SPEED_STANDARD);
+	CHECK(i2c_host_bus.speed == I2C_BUS_SPEED_STANDARD);
+	CHECK(plausible_rate(I2C_BUS_SPEED_STANDARD));
+}
+
+static void test_every_speed_fails(void)
+{
+	// Nothing at the address, the bus has to be left as it was
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, 0);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == -1);
+	CHECK(getI2cBusSpeed() == I2C_BUS_SPEED_STANDARD);
+	CHECK(i2c_host_bus.speed == I2C_BUS_SPEED_STANDARD);
+	CHECK(getI2cBytesPerSecond() == 0);
+}
+
+static void test_failure_keeps_negotiated_speed(void)
+{
+	// A second negotiation that fails keeps what the first one found
+	setup_bus(I2C_BUS_SPEED_FAST_PLUS, I2C_BUS_SPEED_FAST_PLUS);
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == 0);
+	uint32_t rate = getI2cBytesPerSecond();
+	i2c_host_bus.max_device_speed = 0;
+	CHECK(negotiateI2cSpeed(TEST_ADDRESS) == -1);
+	CHECK(getI2cBusSpeed() == I2C_MAX_BUS_SPEED);
+	CHECK(i2c_host_bus.speed == I2C_MAX_BUS_SPEED);
+	CHECK(getI2cBytesPerSecond() == rate);
+}
+
+int main(void)
+{
+	test_getters_before_negotiation();
+	test_picks_fastest_allowed();
+	test_fast_plus_rejected();
+	test_fast_plus_not_acked();
+	test_fast_not_acked();
+	test_every_speed_fails();
+	test_failure_keeps_negotiated_speed();
+
+	printf("i2c_test, max %u Hz: %s, %d failures\n", I2C_MAX_BUS_SPEED, failures ? "FAIL" : "pass", failures);
+	return failures ? 1 : 0;
+}
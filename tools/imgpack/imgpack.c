@@ -0,0 +1,291 @@
+/***************************************************************************************************
+   Name: imgpack.c
+   Host tool that packs a PBM picture into the run-length image format sd1306_draw_packed_img
+   decodes, so splash screens and icons do not cost a whole 1 KB frame each.
+
+   Build and run on the development machine from this directory:
+      gcc -o imgpack imgpack.c
+      ./imgpack splash.pbm splash_img > ../../src/AzureSmartSnoozeAlarmClock/splash_img.h
+
+   The picture can be P1 or P4 PBM, at most 128x64. White is a lit pixel, as in the frames
+   sd1306_host.c dumps; -i takes black as lit instead. The height is padded to whole pages.
+
+   Every run costs the decoder a step, so repeats shorter than -r bytes (8 by default) are kept
+   as literals. -r 3 packs about a quarter smaller, the default decodes about twice as fast as
+   copying a frame.
+
+   Format: width, pages, flags, then runs over the page rows, one byte per column with bit 0 the
+   top row of the page. A control byte c < 0x80 is followed by c + 1 literal bytes, c >= 0x80 by
+   one byte repeated (c & 0x7f) + 2 times. With flag 0x01 every page row is stored XORed with the
+   row above it, which turns shapes repeating down the picture into runs of zeros. Both ways are
+   tried and the smaller one is kept.
+****************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define MAX_WIDTH 128
+#define MAX_HEIGHT 64
+#define MAX_PAGES (MAX_HEIGHT / 8)
+#define HEADER 3
+#define XOR_DELTA 0x01
+// Longest literal and repeat runs a control byte holds
+#define MAX_LITERAL 128
+#define MAX_REPEAT 129
+#define DEFAULT_MIN_REPEAT 8
+
+// Shortest repeat that is not kept as literals
+static int min_repeat = DEFAULT_MIN_REPEAT;
+
+// Picture as page rows of column bytes
+typedef struct Picture
+{
+	int width;
+	int pages;
+	uint8_t columns[MAX_PAGES][MAX_WIDTH];
+} Picture;
+
+/**
+  * @brief  Read the next number of a PBM header, skipping white space and comments.
+  * @param  file: file to read
+  * @retval The number, -1 if there is none.
+  */
+static int read_number(FILE* file)
+{
+	int c;
+	int number = 0;
+
+	do
+	{
+		c = fgetc(file);
+		if (c == '#')
+		{
+			while (c != '\n' && c != EOF)
+			{
+				c = fgetc(file);
+			}
+		}
+	} while (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+
+	if (c < '0' || c > '9')
+	{
+		return -1;
+	}
+	while (c >= '0' && c <= '9')
+	{
+		number = number * 10 + c - '0';
+		c = fgetc(file);
+	}
+	return number;
+}
+
+/**
+  * @brief  Load a P1 or P4 PBM into a picture.
+  * @param  path: file to load
+  * @param  black_lit: take black pixels as lit
+  * @param  picture: loaded picture
+  * @retval Zero if was succefully, negative if was unsuccefully.
+  */
+static int load_pbm(const char* path, int black_lit, Picture* picture)
+{
+	FILE* file = fopen(path, "rb");
+	char magic[2];
+	int height;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return -1;
+	}
+	if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || (magic[1] != '1' && magic[1] != '4'))
+	{
+		fprintf(stderr, "%s is not a P1 or P4 PBM\n", path);
+		fclose(file);
+		return -1;
+	}
+
+	picture->width = read_number(file);
+	height = read_number(file);
+	if (picture->width < 1 || picture->width > MAX_WIDTH || height < 1 || height > MAX_HEIGHT)
+	{
+		fprintf(stderr, "%s is not between 1x1 and %dx%d\n", path, MAX_WIDTH, MAX_HEIGHT);
+		fclose(file);
+		return -1;
+	}
+	picture->pages = (height + 7) / 8;
+	memset(picture->columns, 0, sizeof(picture->columns));
+
+	for (int row = 0; row < height; row++)
+	{
+		int byte = 0;
+		for (int column = 0; column < picture->width; column++)
+		{
+			int black;
+			if (magic[1] == '4')
+			{
+				if (column % 8 == 0 && (byte = fgetc(file)) == EOF)
+				{
+					break;
+				}
+				black = (byte >> (7 - column % 8)) & 1;
+			}
+			else
+			{
+				int c;
+				do
+				{
+					c = fgetc(file);
+				} while (c != '0' && c != '1' && c != EOF);
+				if (c == EOF)
+				{
+					break;
+				}
+				black = c == '1';
+			}
+
+			if (black == black_lit)
+			{
+				picture->columns[row / 8][column] |= 1 << (row % 8);
+			}
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+/**
+  * @brief  Run-length encode bytes.
+  * @param  in: bytes to encode
+  * @param  length: number of bytes
+  * @param  out: encoded runs, worst case length + length / MAX_LITERAL + 1 bytes
+  * @retval Bytes written to out.
+  */
+static int pack_runs(const uint8_t* in, int length, uint8_t* out)
+{
+	int written = 0;
+	int i = 0;
+
+	while (i < length)
+	{
+		int repeat = 1;
+		while (i + repeat < length && repeat < MAX_REPEAT && in[i + repeat] == in[i])
+		{
+			repeat++;
+		}
+		// A short repeat at the end has no literals after it to join
+		if (repeat >= min_repeat || (repeat >= 2 && i + repeat == length))
+		{
+			out[written++] = 0x80 | (repeat - 2);
+			out[written++] = in[i];
+			i += repeat;
+			continue;
+		}
+
+		// Literals until a repeat long enough to be a run
+		int start = i;
+		while (i < length && i - start < MAX_LITERAL)
+		{
+			repeat = 1;
+			while (i + repeat < length && repeat < min_repeat && in[i + repeat] == in[i])
+			{
+				repeat++;
+			}
+			if (repeat >= min_repeat)
+			{
+				break;
+			}
+			i++;
+		}
+		out[written++] = i - start - 1;
+		memcpy(&out[written], &in[start], i - start);
+		written += i - start;
+	}
+	return written;
+}
+
+/**
+  * @brief  Pack a picture.
+  * @param  picture: picture to pack
+  * @param  flags: 0 or XOR_DELTA
+  * @param  out: packed image
+  * @retval Bytes written to out.
+  */
+static int pack(const Picture* picture, uint8_t flags, uint8_t* out)
+{
+	uint8_t rows[MAX_PAGES * MAX_WIDTH];
+	int length = picture->pages * picture->width;
+
+	for (int page = 0; page < picture->pages; page++)
+	{
+		for (int column = 0; column < picture->width; column++)
+		{
+			uint8_t above = (flags & XOR_DELTA) && page > 0 ? picture->columns[page - 1][column] : 0;
+			rows[page * picture->width + column] = picture->columns[page][column] ^ above;
+		}
+	}
+
+	out[0] = picture->width;
+	out[1] = picture->pages;
+	out[2] = flags;
+	return HEADER + pack_runs(rows, length, &out[HEADER]);
+}
+
+int main(int argc, char* argv[])
+{
+	static Picture picture;
+	static uint8_t plain[HEADER + 2 * MAX_PAGES * MAX_WIDTH];
+	static uint8_t delta[HEADER + 2 * MAX_PAGES * MAX_WIDTH];
+	int black_lit = 0;
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-'; arg++)
+	{
+		if (strcmp(argv[arg], "-i") == 0)
+		{
+			black_lit = 1;
+		}
+		else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc)
+		{
+			min_repeat = atoi(argv[++arg]);
+			if (min_repeat < 3 || min_repeat > MAX_REPEAT)
+			{
+				fprintf(stderr, "Run length %s is not between 3 and %d\n", argv[arg], MAX_REPEAT);
+				return 1;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (argc - arg != 2)
+	{
+		fprintf(stderr, "Usage: %s [-i] [-r run] picture.pbm name > name.h\n", argv[0]);
+		return 1;
+	}
+	if (load_pbm(argv[arg], black_lit, &picture) != 0)
+	{
+		return 1;
+	}
+
+	int plain_length = pack(&picture, 0, plain);
+	int delta_length = pack(&picture, XOR_DELTA, delta);
+	const uint8_t* packed = delta_length < plain_length ? delta : plain;
+	int length = delta_length < plain_length ? delta_length : plain_length;
+
+	printf("#pragma once\n\n");
+	printf("// Generated by tools/imgpack/imgpack.c from %s, do not edit.\n", argv[arg]);
+	printf("// %dx%d, %d bytes instead of %d, draw with sd1306_draw_packed_img.\n\n", picture.width, picture.pages * 8,
+		length, picture.width * picture.pages);
+	printf("#include <stdint.h>\n\n");
+	printf("static const uint8_t %s[%d] =\n{", argv[arg + 1], length);
+	for (int i = 0; i < length; i++)
+	{
+		printf("%s0x%02X,", i % 16 ? " " : "\n\t", packed[i]);
+	}
+	printf("\n};\n");
+	return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Portable stand-in for the few NEON intrinsics sd1306_kernels.c uses, so the NEON path's loops
+// can run on a PC. It says nothing about whether the real intrinsics compile, that takes an ARM
+// compiler.
+
+#include <stdint.h>
+
+typedef struct { uint8_t lane[16]; } uint8x16_t;
+typedef struct { uint64_t lane[2]; } uint64x2_t;
+
+static inline uint8x16_t vld1q_u8(const uint8_t* src)
+{
+	uint8x16_t v;
+	for (int i = 0; i < 16; i++) v.lane[i] = src[i];
+	return v;
+}
+
+static inline void vst1q_u8(uint8_t* dst, uint8x16_t v)
+{
+	for (int i = 0; i < 16; i++) dst[i] = v.lane[i];
+}
+
+static inline uint8x16_t vdupq_n_u8(uint8_t value)
+{
+	uint8x16_t v;
+	for (int i = 0; i < 16; i++) v.lane[i] = value;
+	return v;
+}
+
+static inline uint8x16_t vmvnq_u8(uint8x16_t a)
+{
+	for (int i = 0; i < 16; i++) a.lane[i] = (uint8_t)~a.lane[i];
+	return a;
+}
+
+static inline uint8x16_t veorq_u8(uint8x16_t a, uint8x16_t b)
+{
+	for (int i = 0; i < 16; i++) a.lane[i] ^= b.lane[i];
+	return a;
+}
+
+static inline uint8x16_t vorrq_u8(uint8x16_t a, uint8x16_t b)
+{
+	for (int i = 0; i < 16; i++) a.lane[i] |= b.lane[i];
+	return a;
+}
+
+static inline uint64x2_t vreinterpretq_u64_u8(uint8x16_t a)
+{
+	uint64x2_t v;
+	for (int i = 0; i < 2; i++)
+	{
+		v.lane[i] = 0;
+		for (int j = 0; j < 8; j++) v.lane[i] |= (uint64_t)a.lane[i * 8 + j] << (8 * j);
+	}
+	return v;
+}
+
+#define vgetq_lane_u64(v, n) ((v).lane[(n)])
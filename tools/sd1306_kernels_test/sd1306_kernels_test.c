@@ -0,0 +1,219 @@
+/***************************************************************************************************
+   Name: sd1306_kernels_test.c
+   Host test of the kernels in sd1306_kernels.c against byte at a time references. Covers every
+   length up to a few vector widths at every alignment, whole buffers and windows. Prints the
+   path under test and exits non-zero on a mismatch.
+
+   Build and run on the development machine from this directory, once per path:
+      gcc -O2 -Wall -Wextra -I../../src/AzureSmartSnoozeAlarmClock -o kernels_sse2 sd1306_kernels_test.c \
+         ../../src/AzureSmartSnoozeAlarmClock/sd1306_kernels.c
+      gcc -O2 -Wall -Wextra -DSD1306_KERNEL_PORTABLE -I../../src/AzureSmartSnoozeAlarmClock -o kernels_word \
+         sd1306_kernels_test.c ../../src/AzureSmartSnoozeAlarmClock/sd1306_kernels.c
+      ./kernels_sse2 && ./kernels_word
+
+   On an ARM machine with NEON the first line tests the NEON path instead. Off ARM, the NEON loops
+   can still be run against the stand-in intrinsics in neon/:
+      gcc -O2 -Wall -Wextra -DSD1306_KERNEL_NEON -Ineon -I../../src/AzureSmartSnoozeAlarmClock -o kernels_neon \
+         sd1306_kernels_test.c ../../src/AzureSmartSnoozeAlarmClock/sd1306_kernels.c
+****************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "sd1306.h"
+#include "sd1306_kernels.h"
+
+// Longest run tried at every alignment, a few vector widths and a tail
+#define TEST_SHORT 70
+// Alignments tried, a whole vector width
+#define TEST_ALIGN 16
+
+static void reference_fill(uint8_t* dst, uint8_t value, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		dst[i] = value;
+	}
+}
+
+static void reference_invert(uint8_t* dst, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		dst[i] = ~dst[i];
+	}
+}
+
+static void reference_copy(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		dst[i] = src[i];
+	}
+}
+
+static void reference_xor(uint8_t* dst, const uint8_t* src, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		dst[i] ^= src[i];
+	}
+}
+
+static uint32_t reference_first_diff(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	uint32_t i = 0;
+
+	while (i < length && a[i] == b[i])
+	{
+		i++;
+	}
+	return i;
+}
+
+static uint32_t reference_last_diff(const uint8_t* a, const uint8_t* b, uint32_t length)
+{
+	while (length > 0 && a[length - 1] == b[length - 1])
+	{
+		length--;
+	}
+	return length;
+}
+
+static void fill_random(uint8_t* dst, uint32_t length, uint32_t* seed)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		*seed = *seed * 1103515245u + 12345u;
+		dst[i] = (uint8_t)(*seed >> 16);
+	}
+}
+
+static uint32_t report(uint32_t failed, const char* kernel, uint32_t length, uint32_t dst_align, uint32_t src_align)
+{
+	if (failed)
+	{
+		printf("FAIL %s length %u dst +%u src +%u\n", kernel, length, dst_align, src_align);
+	}
+	return failed != 0;
+}
+
+// Checks the run kernels on one run, the bytes around it must not change either
+static uint32_t test_run(uint32_t length, uint32_t dst_align, uint32_t src_align, uint32_t* seed)
+{
+	uint8_t expected[BUFFER_SIZE + TEST_ALIGN];
+	uint8_t actual[BUFFER_SIZE + TEST_ALIGN];
+	uint8_t src[BUFFER_SIZE + TEST_ALIGN];
+	uint8_t* e = &expected[dst_align];
+	uint8_t* a = &actual[dst_align];
+	uint8_t* s = &src[src_align];
+	uint32_t failures = 0;
+	uint32_t wrong = 0;
+
+	fill_random(expected, sizeof(expected), seed);
+	fill_random(src, sizeof(src), seed);
+	memcpy(actual, expected, sizeof(actual));
+
+	reference_fill(e, (uint8_t)*seed, length);
+	sd1306_kernel_fill(a, (uint8_t)*seed, length);
+	failures += report(memcmp(expected, actual, sizeof(actual)), "fill", length, dst_align, src_align);
+
+	reference_invert(e, length);
+	sd1306_kernel_invert(a, length);
+	failures += report(memcmp(expected, actual, sizeof(actual)), "invert", length, dst_align, src_align);
+
+	reference_copy(e, s, length);
+	sd1306_kernel_copy(a, s, length);
+	failures += report(memcmp(expected, actual, sizeof(actual)), "copy", length, dst_align, src_align);
+
+	fill_random(s, length, seed);
+	reference_xor(e, s, length);
+	sd1306_kernel_xor(a, s, length);
+	failures += report(memcmp(expected, actual, sizeof(actual)), "xor", length, dst_align, src_align);
+
+	// Same runs, then one difference at every place, then a difference at both ends
+	reference_copy(a, s, length);
+	wrong += sd1306_kernel_first_diff(a, s, length) != length;
+	wrong += sd1306_kernel_last_diff(a, s, length) != 0;
+	for (uint32_t at = 0; at < length; at++)
+	{
+		a[at] ^= 0x10;
+		wrong += sd1306_kernel_first_diff(a, s, length) != at;
+		wrong += sd1306_kernel_last_diff(a, s, length) != at + 1;
+		a[at] ^= 0x10;
+	}
+	if (length > 1)
+	{
+		a[0] ^= 0x01;
+		a[length - 1] ^= 0x80;
+		wrong += sd1306_kernel_first_diff(a, s, length) != reference_first_diff(a, s, length);
+		wrong += sd1306_kernel_last_diff(a, s, length) != reference_last_diff(a, s, length);
+	}
+	failures += report(wrong, "first_diff/last_diff", length, dst_align, src_align);
+	return failures;
+}
+
+// Checks the window kernels on one window, the rest of the buffer must not change
+static uint32_t test_rect(uint8_t first_page, uint8_t last_page, uint8_t first_col, uint8_t last_col, uint32_t* seed)
+{
+	uint8_t expected[BUFFER_SIZE];
+	uint8_t actual[BUFFER_SIZE];
+	uint8_t src[BUFFER_SIZE];
+	uint32_t width = last_col - first_col + 1;
+	uint32_t wrong = 0;
+
+	fill_random(expected, sizeof(expected), seed);
+	fill_random(src, sizeof(src), seed);
+	memcpy(actual, expected, sizeof(actual));
+
+	for (uint8_t page = first_page; page <= last_page; page++)
+	{
+		uint32_t offset = first_col + page * OLED_WIDTH;
+		reference_fill(&expected[offset], 0x5a, width);
+		reference_invert(&expected[offset], width);
+		reference_xor(&expected[offset], &src[offset], width);
+	}
+	sd1306_kernel_fill_rect(actual, first_page, last_page, first_col, last_col, 0x5a);
+	sd1306_kernel_invert_rect(actual, first_page, last_page, first_col, last_col);
+	sd1306_kernel_xor_rect(actual, src, first_page, last_page, first_col, last_col);
+	wrong += memcmp(expected, actual, sizeof(actual)) != 0;
+
+	sd1306_kernel_copy_rect(actual, src, first_page, last_page, first_col, last_col);
+	wrong += !sd1306_kernel_rect_equal(actual, src, first_page, last_page, first_col, last_col);
+	actual[last_col + last_page * OLED_WIDTH] ^= 0x04;
+	wrong += sd1306_kernel_rect_equal(actual, src, first_page, last_page, first_col, last_col);
+
+	if (wrong)
+	{
+		printf("FAIL rect pages %u-%u columns %u-%u\n", first_page, last_page, first_col, last_col);
+	}
+	return wrong != 0;
+}
+
+int main(void)
+{
+	static const uint8_t cols[][2] = { { 0, OLED_WIDTH - 1 }, { 0, 0 }, { 3, 20 }, { 17, 126 }, { 127, 127 } };
+	uint32_t seed = 1;
+	uint32_t failures = 0;
+
+	for (uint32_t length = 0; length <= TEST_SHORT; length++)
+	{
+		for (uint32_t dst_align = 0; dst_align < TEST_ALIGN; dst_align++)
+		{
+			failures += test_run(length, dst_align, (dst_align * 7 + length) % TEST_ALIGN, &seed);
+		}
+	}
+	failures += test_run(BUFFER_SIZE, 0, 0, &seed);
+	failures += test_run(BUFFER_SIZE - 3, 3, 1, &seed);
+
+	for (uint8_t n = 0; n < sizeof(cols) / sizeof(cols[0]); n++)
+	{
+		for (uint8_t page = 0; page < OLED_PAGES; page++)
+		{
+			failures += test_rect(page, page, cols[n][0], cols[n][1], &seed);
+			failures += test_rect(0, page, cols[n][0], cols[n][1], &seed);
+		}
+	}
+
+	printf("sd1306_kernels_test, %s path: %s, %u failures\n", sd1306_kernel_path(), failures ? "FAIL" : "pass", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+/***************************************************************************************************
+   Name: state_machine_test.c
+   Host test of the button state machine in state_machine.c: every state, button and edge of the
+   transition table, the wrap arounds of the alarm and time zone settings and the debouncing.
+   Exits non-zero if a check fails.
+
+   Build and run on the development machine from this directory:
+      gcc -std=c11 -Wall -Wextra -I../../src/AzureSmartSnoozeAlarmClock -o state_machine_test \
+         state_machine_test.c ../../src/AzureSmartSnoozeAlarmClock/state_machine.c
+      ./state_machine_test
+
+   -std=c11 keeps <time.h> from declaring the POSIX timezone variable, which the app's time zone
+   text shares a name with.
+****************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "state_machine.h"
+
+#define CHECK(condition) check((condition), #condition, __func__, __LINE__)
+
+// Settings every case starts from
+#define START_HOUR 7
+#define START_MINUTE 30
+#define START_OFFSET 120
+#define START_TIME_ZONE "+05"
+// Settings a transition leaves alone
+#define UNCHANGED START_HOUR, START_MINUTE, false, START_OFFSET, START_TIME_ZONE
+
+static int failures;
+
+static void check(int passed, const char* condition, const char* test, int line)
+{
+	if (!passed)
+	{
+		printf("FAIL %s:%d: %s\n", test, line, condition);
+		failures++;
+	}
+}
+
+// Calls the state machine made to the rest of the app
+static struct
+{
+	int saves;
+	int alarmsSet;
+	int timeZonesSet;
+	int alarmsEnded;
+	int snoozes;
+	int renders;
+	// What the next setTimeZone returns
+	int timeZoneResult;
+} calls;
+
+static int saveSettingsHook(void) { calls.saves++; return 0; }
+static void setCurrentAlarmHook(void) { calls.alarmsSet++; }
+static int setTimeZoneHook(void) { calls.timeZonesSet++; return calls.timeZoneResult; }
+static void endSoundAlarmHook(void) { calls.alarmsEnded++; }
+static void startSnoozeHook(void) { calls.snoozes++; }
+static void requestRenderHook(void) { calls.renders++; }
+
+static const StateMachineHooks hooks = {
+	.saveSettings = &saveSettingsHook,
+	.setCurrentAlarm = &setCurrentAlarmHook,
+	.setTimeZone = &setTimeZoneHook,
+	.endSoundAlarm = &endSoundAlarmHook,
+	.startSnooze = &startSnoozeHook,
+	.requestRender = &requestRenderHook
+};
+
+static void reset(enum runningState state)
+{
+	memset(&calls, 0, sizeof(calls));
+	currentState = state;
+	alarmTime = (AlarmTime){ .hour = START_HOUR, .minute = START_MINUTE, .offsetSeconds = START_OFFSET, .active = false };
+	strcpy(timezone, START_TIME_ZONE);
+	for (int i = 0; i < ButtonCount; i++)
+	{
+		resetButton(i, false);
+	}
+}
+
+// Feeds a clean edge, exactly as many samples as debouncing takes
+static void edge(enum buttonName button, enum buttonEdge buttonEdge)
+{
+	bool pressed = buttonEdge == ButtonPressed;
+
+	resetButton(button, !pressed);
+	for (int i = 0; i < BUTTON_DEBOUNCE_SAMPLES; i++)
+	{
+		sampleButton(button, pressed);
+	}
+}
+
+struct transition
+{
+	enum runningState state;
+	enum buttonName button;
+	enum buttonEdge edge;
+	enum runningState next;
+	uint8_t hour;
+	uint8_t minute;
+	bool active;
+	uint16_t offsetSeconds;
+	const char* timezone;
+	int saves;
+	int alarmsSet;
+	int timeZonesSet;
+	int alarmsEnded;
+	int snoozes;
+};
+
+// Every edge that does something, all the others must leave everything but the render alone
+static const struct transition transitions[] = {
+	{ Normal, ButtonA, ButtonPressed, DisplayAlarm, UNCHANGED, 0, 0, 0, 0, 0 },
+	{ Normal, ButtonSet, ButtonPressed, SetSettings, UNCHANGED, 0, 0, 0, 0, 0 },
+
+	{ DisplayAlarm, ButtonA, ButtonReleased, Normal, UNCHANGED, 1, 0, 0, 0, 0 },
+	{ DisplayAlarm, ButtonC, ButtonPressed, DisplayAlarm, START_HOUR, START_MINUTE, true, START_OFFSET, START_TIME_ZONE, 0, 0, 0, 0, 0 },
+
+	{ SetSettings, ButtonA, ButtonPressed, SetAlarmHour, UNCHANGED, 0, 0, 0, 0, 0 },
+	{ SetSettings, ButtonC, ButtonPressed, SetTimeZone, UNCHANGED, 0, 0, 0, 0, 0 },
+
+	{ SetAlarmHour, ButtonA, ButtonPressed, SetAlarmHour, START_HOUR - 1, START_MINUTE, false, START_OFFSET, START_TIME_ZONE, 0, 0, 0, 0, 0 },
+	{ SetAlarmHour, ButtonB, ButtonPressed, SetAlarmHour, START_HOUR + 1, START_MINUTE, false, START_OFFSET, START_TIME_ZONE, 0, 0, 0, 0, 0 },
+	{ SetAlarmHour, ButtonSet, ButtonReleased, SetAlarmMinute, UNCHANGED, 0, 0, 0, 0, 0 },
+
+	{ SetAlarmMinute, ButtonA, ButtonPressed, SetAlarmMinute, START_HOUR, START_MINUTE - 1, false, START_OFFSET, START_TIME_ZONE, 0, 0, 0, 0, 0 },
+	{ SetAlarmMinute, ButtonB, ButtonPressed, SetAlarmMinute, START_HOUR, START_MINUTE + 1, false, START_OFFSET, START_TIME_ZONE, 0, 0, 0, 0, 0 },
+	{ SetAlarmMinute, ButtonSet, ButtonReleased, Normal, START_HOUR, START_MINUTE, false, 0, START_TIME_ZONE, 1, 1, 0, 0, 0 },
+
+	{ SetTimeZone, ButtonA, ButtonPressed, SetTimeZone, START_HOUR, START_MINUTE, false, START_OFFSET, "-05", 0, 0, 0, 0, 0 },
+	{ SetTimeZone, ButtonB, ButtonPressed, SetTimeZone, START_HOUR, START_MINUTE, false, START_OFFSET, "+04", 0, 0, 0, 0, 0 },
+	{ SetTimeZone, ButtonC, ButtonPressed, SetTimeZone, START_HOUR, START_MINUTE, false, START_OFFSET, "+06", 0, 0, 0, 0, 0 },
+	{ SetTimeZone, ButtonSet, ButtonReleased, Normal, UNCHANGED, 1, 1, 1, 0, 0 },
+
+	{ SoundAlarm, ButtonA, ButtonPressed, Normal, UNCHANGED, 0, 0, 0, 1, 0 },
+	{ SoundAlarm, ButtonA, ButtonReleased, Normal, UNCHANGED, 0, 0, 0, 1, 0 },
+	{ SoundAlarm, ButtonSet, ButtonPressed, Snooze, UNCHANGED, 0, 0, 0, 0, 1 },
+	{ SoundAlarm, ButtonSet, ButtonReleased, Snooze, UNCHANGED, 0, 0, 0, 0, 1 },
+
+	{ Snooze, ButtonA, ButtonPressed, Normal, UNCHANGED, 0, 0, 0, 1, 0 },
+	{ Snooze, ButtonA, ButtonReleased, Normal, UNCHANGED, 0, 0, 0, 1, 0 }
+};
+
+static struct transition expected_transition(enum runningState state, enum buttonName button, enum buttonEdge buttonEdge)
+{
+	for (size_t i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i++)
+	{
+		if (transitions[i].state == state && transitions[i].button == button && transitions[i].edge == buttonEdge)
+		{
+			return transitions[i];
+		}
+	}
+	return (struct transition){ state, button, buttonEdge, state, UNCHANGED, 0, 0, 0, 0, 0 };
+}
+
+static void test_every_transition(void)
+{
+	for (int state = 0; state < StateCount; state++)
+	{
+		for (int button = 0; button < ButtonCount; button++)
+		{
+			for (int buttonEdge = 0; buttonEdge < EdgeCount; buttonEdge++)
+			{
+				struct transition x = expected_transition(state, button, buttonEdge);
+				int before = failures;
+
+				reset(state);
+				edge(button, buttonEdge);
+				CHECK(currentState == x.next);
+				CHECK(alarmTime.hour == x.hour);
+				CHECK(alarmTime.minute == x.minute);
+				CHECK(alarmTime.active == x.active);
+				CHECK(alarmTime.offsetSeconds == x.offsetSeconds);
+				CHECK(strcmp(timezone, x.timezone) == 0);
+				CHECK(calls.saves == x.saves);
+				CHECK(calls.alarmsSet == x.alarmsSet);
+				CHECK(calls.timeZonesSet == x.timeZonesSet);
+				CHECK(calls.alarmsEnded == x.alarmsEnded);
+				CHECK(calls.snoozes == x.snoozes);
+				CHECK(calls.renders == 1);
+				if (failures != before)
+				{
+					printf("     in state %d, button %d, edge %d\n", state, button, buttonEdge);
+				}
+			}
+		}
+	}
+}
+
+static void test_time_zone_not_applied(void)
+{
+	// A zone that cannot be set is not saved and the screen stays up
+	reset(SetTimeZone);
+	calls.timeZoneResult = -1;
+	edge(ButtonSet, ButtonReleased);
+	CHECK(currentState == SetTimeZone);
+	CHECK(calls.timeZonesSet == 1);
+	CHECK(calls.saves == 0);
+	CHECK(calls.alarmsSet == 0);
+}
+
+static void test_hour_wraps(void)
+{
+	reset(SetAlarmHour);
+	alarmTime.hour = 0;
+	edge(ButtonA, ButtonPressed);
+	CHECK(alarmTime.hour == 23);
+	edge(ButtonB, ButtonPressed);
+	CHECK(alarmTime.hour == 0);
+}
+
+static void test_minute_wraps(void)
+{
+	reset(SetAlarmMinute);
+	alarmTime.minute = 0;
+	edge(ButtonA, ButtonPressed);
+	CHECK(alarmTime.minute == 59);
+	edge(ButtonB, ButtonPressed);
+	CHECK(alarmTime.minute == 0);
+}
+
+static void test_time_zone_wraps(void)
+{
+	reset(SetTimeZone);
+	strcpy(timezone, "+00");
+	edge(ButtonB, ButtonPressed);
+	CHECK(strcmp(timezone, "+23") == 0);
+	edge(ButtonC, ButtonPressed);
+	CHECK(strcmp(timezone, "+00") == 0);
+	edge(ButtonA, ButtonPressed);
+	CHECK(strcmp(timezone, "-00") == 0);
+	edge(ButtonA, ButtonPressed);
+	CHECK(strcmp(timezone, "+00") == 0);
+}
+
+static void test_edge_takes_debounce_samples(void)
+{
+	reset(Normal);
+	for (int i = 0; i < BUTTON_DEBOUNCE_SAMPLES - 1; i++)
+	{
+		CHECK(sampleButton(ButtonA, true));
+	}
+	CHECK(currentState == Normal);
+	CHECK(calls.renders == 0);
+	CHECK(sampleButton(ButtonA, true));
+	CHECK(currentState == DisplayAlarm);
+	CHECK(calls.renders == 1);
+
+	// Held down is still active, but no more edges
+	CHECK(sampleButton(ButtonA, true));
+	CHECK(calls.renders == 1);
+	CHECK(buttonDebounce[ButtonA].pressed);
+}
+
+static void test_bouncing_line_never_settles(void)
+{
+	// Runs of every length short of debouncing, again and again, never make an edge
+	reset(Normal);
+	for (int round = 0; round < 100; round++)
+	{
+		for (int run = 1; run < BUTTON_DEBOUNCE_SAMPLES; run++)
+		{
+			for (int i = 0; i < run; i++)
+			{
+				CHECK(sampleButton(ButtonSet, true));
+			}
+			CHECK(!sampleButton(ButtonSet, false));
+		}
+	}
+	CHECK(currentState == Normal);
+	CHECK(calls.renders == 0);
+	CHECK(!buttonDebounce[ButtonSet].pressed);
+
+	// Once it settles it makes exactly one edge
+	for (int i = 0; i < BUTTON_DEBOUNCE_SAMPLES; i++)
+	{
+		sampleButton(ButtonSet, true);
+	}
+	CHECK(currentState == SetSettings);
+	CHECK(calls.renders == 1);
+}
+
+static void test_idle_button_is_quiet(void)
+{
+	reset(Normal);
+	for (int i = 0; i < 10; i++)
+	{
+		CHECK(!sampleButton(ButtonB, false));
+	}
+	CHECK(calls.renders == 0);
+}
+
+int main(void)
+{
+	setStateMachineHooks(&hooks);
+
+	test_every_transition();
+	test_time_zone_not_applied();
+	test_hour_wraps();
+	test_minute_wraps();
+	test_time_zone_wraps();
+	test_edge_takes_debounce_samples();
+	test_bouncing_line_never_settles();
+	test_idle_button_is_quiet();
+
+	printf("state_machine_test: %s, %d failures\n", failures ? "FAIL" : "pass", failures);
+	return failures ? 1 : 0;
+}